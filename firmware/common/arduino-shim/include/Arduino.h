@@ -0,0 +1,91 @@
+#pragma once
+
+// Just enough of the Arduino core to build firmware modules on the host
+// (PlatformIO `native` env). Only pulled in where the real core is absent.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+// The ESP8266 core exposes these the same way
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef uint8_t u8_t;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x00
+#define OUTPUT 0x01
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN 2
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+/* Host side: us since boot behind millis()/micros(), e.g. a simulation's
+   virtual clock. nullptr goes back to the real one */
+void setMicrosSource(uint64_t (*source)());
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { _baud = baud; }
+  void end() {}
+  unsigned long baudRate() const { return _baud; }
+
+  int available();
+  int read();
+  int peek();
+  size_t readBytes(uint8_t* buffer, size_t length);
+
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buffer, size_t size);
+  int availableForWrite() { return 256; }
+  void flush() {}
+
+  /* Host side: bytes pushed here come out of read(), writes land in tx() */
+  void inject(const uint8_t* data, size_t len);
+  void captureTx(bool enabled) { _capture = enabled; }
+  const std::vector<uint8_t>& tx() const { return _tx; }
+  size_t txCount() const { return _txCount; }
+  void clear();
+
+private:
+  unsigned long _baud = 0;
+
+  std::vector<uint8_t> _rx;
+  size_t _rxPos = 0;
+
+  std::vector<uint8_t> _tx;
+  size_t _txCount = 0;
+  bool _capture = false;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getFreeHeap() { return 0; }
+  uint8_t getCpuFreqMHz() { return 80; }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,114 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point boot = Clock::now();
+
+  uint64_t (*microsSource)() = nullptr;
+}
+
+unsigned long millis() {
+  if (microsSource) return microsSource() / 1000;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - boot).count();
+}
+
+unsigned long micros() {
+  if (microsSource) return microsSource();
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - boot).count();
+}
+
+void setMicrosSource(uint64_t (*source)()) {
+  microsSource = source;
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {}
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int  digitalRead(uint8_t) { return LOW; }
+
+long random(long max) {
+  return max > 0 ? ::random() % max : 0;
+}
+
+long random(long min, long max) {
+  return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  ::srandom(seed);
+}
+
+uint32_t EspClass::getCycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+  return static_cast<uint32_t>(__rdtsc());
+#else
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - boot).count());
+#endif
+}
+
+/* ---------------- Serial ---------------- */
+
+int HardwareSerial::available() {
+  return static_cast<int>(_rx.size() - _rxPos);
+}
+
+int HardwareSerial::read() {
+  if (_rxPos >= _rx.size()) return -1;
+  return _rx[_rxPos++];
+}
+
+int HardwareSerial::peek() {
+  if (_rxPos >= _rx.size()) return -1;
+  return _rx[_rxPos];
+}
+
+size_t HardwareSerial::readBytes(uint8_t* buffer, size_t length) {
+  size_t n = _rx.size() - _rxPos;
+  if (n > length) n = length;
+  memcpy(buffer, _rx.data() + _rxPos, n);
+  _rxPos += n;
+  return n;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  ++_txCount;
+  if (_capture) _tx.push_back(b);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  _txCount += size;
+  if (_capture) _tx.insert(_tx.end(), buffer, buffer + size);
+  return size;
+}
+
+void HardwareSerial::inject(const uint8_t* data, size_t len) {
+  // Drop what has been consumed so a long running feed does not grow forever
+  if (_rxPos == _rx.size()) {
+    _rx.clear();
+    _rxPos = 0;
+  }
+  _rx.insert(_rx.end(), data, data + len);
+}
+
+void HardwareSerial::clear() {
+  _rx.clear();
+  _rxPos = 0;
+  _tx.clear();
+  _txCount = 0;
+}
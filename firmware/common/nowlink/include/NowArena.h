@@ -0,0 +1,72 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed buffer allocator for a JsonDocument that is cleared after every use.
+// Blocks are bumped off the buffer, freeing only rewinds the newest one and
+// reset() (after JsonDocument::clear()) takes everything back. Running out
+// returns nullptr, which ArduinoJson reports as overflowed().
+template<size_t N>
+class NowArena : public ArduinoJson::Allocator {
+public:
+  void* allocate(size_t size) override {
+    size_t need = HEADER + align(size);
+    if (N - _used < need) return nullptr;
+
+    uint8_t* block = _buf + _used;
+    memcpy(block, &size, sizeof(size));
+    _last = _used;
+    _used += need;
+    return block + HEADER;
+  }
+
+  void deallocate(void* ptr) override {
+    if (ptr && isLast(ptr)) _used = _last;
+  }
+
+  void* reallocate(void* ptr, size_t size) override {
+    if (!ptr) return allocate(size);
+
+    size_t old = sizeOf(ptr);
+    if (isLast(ptr)) {
+      size_t need = HEADER + align(size);
+      if (N - _last < need) return nullptr;
+      _used = _last + need;
+      memcpy((uint8_t*)ptr - HEADER, &size, sizeof(size));
+      return ptr;
+    }
+    if (size <= old) return ptr;
+
+    void* moved = allocate(size);
+    if (moved) memcpy(moved, ptr, old);
+    return moved;
+  }
+
+  void reset() {
+    _used = 0;
+    _last = 0;
+  }
+
+  size_t used() const { return _used; }
+
+private:
+  static constexpr size_t ALIGN = 8;
+  static constexpr size_t HEADER = ALIGN; // block size, keeps blocks aligned
+
+  alignas(ALIGN) uint8_t _buf[N];
+  size_t _used = 0;
+  size_t _last = 0;
+
+  static size_t align(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
+
+  bool isLast(void* ptr) const { return ptr == _buf + _last + HEADER && _last < _used; }
+
+  static size_t sizeOf(void* ptr) {
+    size_t size;
+    memcpy(&size, (uint8_t*)ptr - HEADER, sizeof(size));
+    return size;
+  }
+};
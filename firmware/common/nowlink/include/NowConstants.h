@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 namespace NowConstants {
   namespace Keys {
     constexpr const char* TYPE        = ".t";
@@ -9,11 +11,21 @@ namespace NowConstants {
     constexpr const char* STATE       = "stat";
     constexpr const char* BRIGHTNESS  = "br";
     constexpr const char* SUPPORTED_COLOR_MODES  = "sup_clrm";
+    constexpr const char* STATES      = "e";
+    constexpr const char* HANDLE      = "n";
+    constexpr const char* WINDOW      = "w";
+    constexpr const char* SLEEPY      = "slp";
+  }
+
+  namespace Codec {
+    // Leads a MessagePack payload, a byte neither JSON nor MessagePack starts with
+    constexpr uint8_t MSGPACK_MARKER = 0xC1;
   }
 
   namespace Types {
     constexpr const char* DISCOVERY   = "d";
     constexpr const char* HYBRID      = "h";
     constexpr const char* STATE       = "s";
+    constexpr const char* BATCH       = "b";
   }
 }
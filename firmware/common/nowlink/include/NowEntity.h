@@ -6,13 +6,31 @@ public:
   virtual const char* id()       const = 0;
   virtual const char* platform() const = 0;
 
-  virtual void serializeDiscovery(JsonDocument&) const = 0;
-  virtual void serializeState    (JsonDocument&) const = 0;
+  // Entity fields only, NowLink adds the type, dev_id and handle. Discovery
+  // names the entity (platform, id, ...), states go by handle alone
+  virtual void serializeDiscovery(JsonObject) const = 0;
+  virtual void serializeState    (JsonObject) const = 0;
 
   virtual bool  isDirty()  const = 0;
   virtual void  clearDirty()     = 0;
 
   virtual void handlePayload(const JsonDocument&) {}
 
+  // Publish throttling in ms, 0 for both (the default) sends on the next
+  // loop. A fresh change is held up to maxLatency for a burst to collapse
+  // into it and frames go at least minInterval apart, only the newest value
+  // is sent either way
+  void throttle(uint16_t minInterval, uint16_t maxLatency = 0) {
+    _minInterval = minInterval;
+    _maxLatency  = maxLatency;
+  }
+
+  uint16_t minInterval() const { return _minInterval; }
+  uint16_t maxLatency()  const { return _maxLatency; }
+
   virtual ~NowEntity() {}
+
+private:
+  uint16_t _minInterval = 0;
+  uint16_t _maxLatency  = 0;
 };
\ No newline at end of file
@@ -4,156 +4,553 @@
 #include <functional>
 #include <string.h>
 
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
 class NowEntity;
 
 namespace NowLink {
   using SendCallback = std::function<bool(const uint8_t* data, size_t len)>;
+  using Clock = uint32_t (*)(); // ms, wraps like millis()
+
+  // Encoding of outgoing payloads, incoming ones are read in either
+  enum Codec : uint8_t {
+    CODEC_JSON,
+    CODEC_MSGPACK  // MessagePack behind NowConstants::Codec::MSGPACK_MARKER
+  };
 
   void begin(const char* deviceId);
   void loop();
   const char* id();
   void handlePacket(const uint8_t* data, size_t len);
   void setSendCallback(SendCallback cb);
+  void setCodec(Codec codec);
+  void setClock(Clock clock);
+
+  // Keep states pending until the radio reports them delivered, needs every
+  // send status passed to handleSendStatus() (ESP-NOW onDataSent)
+  void setDeliveryTracking(bool on);
+  void handleSendStatus(bool delivered);
+
+  // Battery devices that sleep between wakes: discovery flags the device so
+  // the host holds its downlink in the gateway mailbox, which releases it
+  // once the device is heard. readyToSleep() tells when everything went out
+  // and nothing was sent for listenMs, 0 turns the mode off
+  void setSleepy(uint16_t listenMs);
+  bool readyToSleep();
+
+  // Several devices in one process (host simulations): an Instance holds one
+  // device's whole state, every call goes to the selected one and entities
+  // register with the one selected when they are constructed
+  struct Instance;
+  Instance* create();
+  Instance* select(Instance* instance); // returns the one selected before
 
   void registerEntity(NowEntity* e, bool init_discovery);
 }
 
 #include "NowEntity.h"
 #include "NowConstants.h"
+#include "NowArena.h"
+
+// Per document, enough for one pool of ArduinoJson slots plus the strings
+// (2 KB on the ESP8266, slots double in size on 64 bit hosts)
+#ifndef NOWLINK_ARENA_SIZE
+#define NOWLINK_ARENA_SIZE (512 * sizeof(void*))
+#endif
+
+// Registry capacity, entity handles run from 0 to NOWLINK_MAX_ENTITIES - 1
+#ifndef NOWLINK_MAX_ENTITIES
+#define NOWLINK_MAX_ENTITIES 10
+#endif
+
+// Delivery tracking: a send status that never comes counts as a failure,
+// failed states go out again after a backoff doubling up to the max
+#ifndef NOWLINK_ACK_TIMEOUT_MS
+#define NOWLINK_ACK_TIMEOUT_MS 100
+#endif
+
+#ifndef NOWLINK_RETRY_BASE_MS
+#define NOWLINK_RETRY_BASE_MS 50
+#endif
+
+#ifndef NOWLINK_RETRY_MAX_MS
+#define NOWLINK_RETRY_MAX_MS 2000
+#endif
+
+// Discovery pacing: announcements start after a random delay below the
+// jitter (or the window of a broadcast rediscover request) and then go out
+// one per interval
+#ifndef NOWLINK_DISCOVERY_INTERVAL_MS
+#define NOWLINK_DISCOVERY_INTERVAL_MS 100
+#endif
+
+#ifndef NOWLINK_DISCOVERY_JITTER_MS
+#define NOWLINK_DISCOVERY_JITTER_MS 250
+#endif
+
+#ifndef NOWLINK_REDISCOVER_WINDOW_MS
+#define NOWLINK_REDISCOVER_WINDOW_MS 3000
+#endif
 
 namespace {
   namespace K = NowConstants::Keys;
   namespace T = NowConstants::Types;
+  namespace C = NowConstants::Codec;
 
+  // Largest ESP-NOW payload
+  constexpr size_t MAX_PAYLOAD = 250;
+
+  // Entities indexed by handle, the handle being the registration order
+  // (stable for a given firmware), so dispatch is a bounds check
+  template<uint8_t N>
   struct Registry {
-    static constexpr uint8_t MAX = 10;
-    NowEntity* arr[MAX];
+    static constexpr uint8_t MAX = N;
+    static constexpr uint8_t NO_HANDLE = 0xFF;
+    static_assert(N < NO_HANDLE, "NOWLINK_MAX_ENTITIES must stay below 255");
+
+    NowEntity* arr[N];
     uint8_t n = 0;
 
-    bool add(NowEntity* e) {
-      if (n < MAX) {
-        arr[n++] = e;
-        return true;
-      }
-      return false;
+    uint8_t add(NowEntity* e) {
+      if (n >= N) return NO_HANDLE;
+      arr[n] = e;
+      return n++;
+    }
+
+    NowEntity* at(uint8_t h) const {
+      return h < n ? arr[h] : nullptr;
     }
 
     template<typename F>
     void forEach(F&& f) {
       for (uint8_t i = 0; i < n; ++i)
-        f(*arr[i]);
+        f(i, *arr[i]);
     }
 
-    NowEntity* find(const char* id) {
+    // Only for hosts that still address entities by id
+    uint8_t find(const char* id) const {
       for (uint8_t i = 0; i < n; ++i)
         if (!strcmp(id, arr[i]->id()))
-          return arr[i];
-      return nullptr;
+          return i;
+      return NO_HANDLE;
     }
   };
 
-  struct DiscoveryRequest {
-    NowEntity* ent;
+  uint32_t defaultClock() {
+#ifdef ARDUINO
+    return millis();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+  // When an entity last went out, since when it has been waiting and
+  // whether its last state still has to be delivered
+  struct Pacing {
+    uint32_t sentAt;
+    uint32_t dirtyAt;
+    uint32_t retryAt;
     uint8_t attempts;
+    bool sent;
+    bool waiting;
+    bool retry;
+  };
+
+  // Frame on air while delivery is tracked, loop() sends nothing else until
+  // its status is in. Handles are the states or the announcement it carried
+  template<uint8_t N>
+  struct Outbox {
+    static constexpr uint8_t NONE = 0xFF;
+
+    uint8_t handles[N];
+    uint8_t n = 0;
+    uint8_t discovery = NONE;
+    bool busy = false;
+    uint32_t sentAt = 0;
+    volatile bool reported = false;
+    volatile bool delivered = false;
+
+    void start(uint32_t now) {
+      busy = true;
+      n = 0;
+      discovery = NONE;
+      sentAt = now;
+    }
+
+    void hold(const uint8_t* h, uint8_t count) {
+      memcpy(handles, h, count);
+      n = count;
+    }
+
+    void report(bool ok) {
+      delivered = ok;
+      reported = true;
+    }
   };
 
-  struct DiscoveryQueue {
-    static constexpr uint8_t Q = 5;
-    DiscoveryRequest q[Q];
-    uint8_t h = 0, t = 0, c = 0;
+  // Entities waiting to be announced, one flag per handle so repeated
+  // requests collapse and none is ever dropped. Announcements go at least
+  // NOWLINK_DISCOVERY_INTERVAL_MS apart, after a start delay the caller picks
+  template<uint8_t N>
+  struct DiscoveryScheduler {
+    bool pending[N] = {};
+    uint8_t count = 0;
+    uint8_t next = 0;     // round robin over the handles
+    uint32_t startAt = 0; // when the pending announcements may begin
+    uint32_t lastAt = 0;
+    bool announced = false;
+
+    void delay(uint32_t now, uint32_t ms) {
+      startAt = now + ms;
+    }
+
+    void push(uint8_t h, uint32_t now, uint32_t startDelay) {
+      if (h >= N || pending[h]) return;
+      if (!count) delay(now, startDelay);
+      pending[h] = true;
+      ++count;
+    }
 
-    void push(NowEntity* e) {
-      if (c < Q) {
-        q[t] = { e, 0 };
-        t = (t + 1) % Q;
-        ++c;
+    void pushAll(uint8_t n, uint32_t now, uint32_t startDelay) {
+      delay(now, startDelay);
+      for (uint8_t h = 0; h < n; ++h) {
+        if (pending[h]) continue;
+        pending[h] = true;
+        ++count;
       }
     }
 
-    bool pop(DiscoveryRequest& out) {
-      if (!c) return false;
-      out = q[h];
-      h = (h + 1) % Q;
-      --c;
+    bool pop(uint32_t now, uint8_t& out) {
+      if (!count || (int32_t)(now - startAt) < 0) return false;
+      if (announced && now - lastAt < NOWLINK_DISCOVERY_INTERVAL_MS) return false;
+
+      while (!pending[next]) next = (next + 1) % N;
+      out = next;
+      pending[next] = false;
+      --count;
+      lastAt = now;
+      announced = true;
       return true;
     }
   };
 
   struct Core {
     const char* devId = "";
-    Registry reg;
-    DiscoveryQueue dq;
+    Registry<NOWLINK_MAX_ENTITIES> reg;
+    DiscoveryScheduler<NOWLINK_MAX_ENTITIES> ds;
+    uint32_t seed = 1;
     NowLink::SendCallback sender = nullptr;
-    JsonDocument _payload;
+    NowLink::Codec codec = NowLink::CODEC_JSON;
+    NowLink::Clock clock = defaultClock;
+    Pacing pacing[NOWLINK_MAX_ENTITIES] = {};
+    bool tracking = false;
+    Outbox<NOWLINK_MAX_ENTITIES> outbox;
+    uint16_t listenMs = 0; // sleepy mode
+    uint32_t lastTxAt = 0;
+
+    // Documents live in fixed arenas and payloads are written to _out, the
+    // steady state send and receive paths never touch the heap
+    NowArena<NOWLINK_ARENA_SIZE> _txArena;
+    NowArena<NOWLINK_ARENA_SIZE> _rxArena;
+    JsonDocument _tx{&_txArena};
+    JsonDocument _payload{&_rxArena};
+    uint8_t _out[MAX_PAYLOAD + 1]; // + serializeJson's terminator
+
+    JsonDocument& txDocument() {
+      _tx.clear();
+      _txArena.reset();
+      return _tx;
+    }
+
+    bool transmit(size_t len) {
+      outbox.reported = false;
+      if (!sender(_out, len)) return false;
+      lastTxAt = clock();
+      if (tracking) outbox.start(clock());
+      return true;
+    }
 
     bool send(const JsonDocument& d) {
-      if (!sender) return false;
-      String buf;
-      size_t len = serializeJson(d, buf);
-      return sender((const uint8_t*)buf.c_str(), len);
+      if (!sender || d.overflowed()) return false;
+
+      if (codec == NowLink::CODEC_MSGPACK) {
+        size_t len = measureMsgPack(d);
+        if (len + 1 > MAX_PAYLOAD) return false;
+
+        _out[0] = C::MSGPACK_MARKER;
+        serializeMsgPack(d, _out + 1, len);
+        return transmit(len + 1);
+      }
+
+      size_t len = measureJson(d);
+      if (len > MAX_PAYLOAD) return false;
+
+      serializeJson(d, (char*)_out, sizeof(_out));
+      return transmit(len);
+    }
+
+    bool fits(const JsonDocument& d) const {
+      if (d.overflowed()) return false;
+      size_t len = codec == NowLink::CODEC_MSGPACK ? 1 + measureMsgPack(d) : measureJson(d);
+      return len <= MAX_PAYLOAD;
+    }
+
+    void writeState(JsonObject obj, uint8_t h) {
+      obj[K::HANDLE] = h;
+      reg.at(h)->serializeState(obj);
+    }
+
+    // One entity goes out as a plain state frame, more share a batch that
+    // carries dev_id once: {".t":"b","dev_id":..,"e":[{"n":..,state}, ...]}
+    JsonDocument& buildStates(const uint8_t* handles, uint8_t n) {
+      JsonDocument& d = txDocument();
+      d[K::TYPE] = n == 1 ? T::STATE : T::BATCH;
+      d[K::DEVICE_ID] = devId;
+
+      if (n == 1) {
+        writeState(d.as<JsonObject>(), handles[0]);
+        return d;
+      }
+
+      JsonArray states = d[K::STATES].to<JsonArray>();
+      for (uint8_t i = 0; i < n; ++i)
+        writeState(states.add<JsonObject>(), handles[i]);
+      return d;
+    }
+
+    void sendStates(const uint8_t* handles, uint8_t n, uint32_t now) {
+      if (!send(buildStates(handles, n))) return;
+      if (outbox.busy) outbox.hold(handles, n);
+
+      for (uint8_t i = 0; i < n; ++i) {
+        reg.at(handles[i])->clearDirty();
+        Pacing& p = pacing[handles[i]];
+        p.sentAt = now;
+        p.sent = true;
+        p.waiting = false;
+      }
+    }
+
+    static uint32_t backoff(uint8_t attempts) {
+      uint32_t ms = (uint32_t)NOWLINK_RETRY_BASE_MS << (attempts < 8 ? attempts - 1 : 7);
+      return ms < NOWLINK_RETRY_MAX_MS ? ms : NOWLINK_RETRY_MAX_MS;
+    }
+
+    // xorshift32, seeded from the device id so devices hit by the same
+    // broadcast pick different delays
+    uint32_t jitter(uint32_t below) {
+      seed ^= seed << 13;
+      seed ^= seed >> 17;
+      seed ^= seed << 5;
+      return below ? seed % below : 0;
+    }
+
+    void seedJitter() {
+      uint32_t h = 2166136261u; // FNV-1a
+      for (const char* c = devId; *c; ++c) h = (h ^ (uint8_t)*c) * 16777619u;
+      seed = (h ^ clock()) | 1;
+    }
+
+    // Undelivered states are sent again later with whatever the entity holds
+    // by then, so a newer state replaces the one that was lost
+    void complete(bool delivered, uint32_t now) {
+      outbox.busy = false;
+      if (!delivered && outbox.discovery != outbox.NONE)
+        ds.push(outbox.discovery, now, 0);
+      for (uint8_t i = 0; i < outbox.n; ++i) {
+        Pacing& p = pacing[outbox.handles[i]];
+        if (delivered) {
+          p.attempts = 0;
+          p.retry = false;
+          continue;
+        }
+        if (p.attempts < UINT8_MAX) ++p.attempts;
+        p.retry = true;
+        p.retryAt = now + backoff(p.attempts);
+      }
+    }
+
+    // Whether the tracked frame on air still holds up loop()
+    bool awaitingStatus(uint32_t now) {
+      if (!outbox.busy) return false;
+      if (outbox.reported)
+        complete(outbox.delivered, now);
+      else if (now - outbox.sentAt > NOWLINK_ACK_TIMEOUT_MS)
+        complete(false, now);
+      return outbox.busy;
+    }
+
+    bool pending(uint8_t h, const NowEntity& e) const {
+      return e.isDirty() || pacing[h].retry;
+    }
+
+    // Dirty entities stay dirty while throttled, so whatever they hold when
+    // they come due is the only value sent
+    bool due(uint8_t h, const NowEntity& e, uint32_t now) {
+      Pacing& p = pacing[h];
+      if (p.retry) return (int32_t)(now - p.retryAt) >= 0;
+      if (!p.waiting) {
+        p.waiting = true;
+        p.dirtyAt = now;
+      }
+      if (now - p.dirtyAt < e.maxLatency()) return false;
+      return !p.sent || now - p.sentAt >= e.minInterval();
     }
 
     void loop() {
-      reg.forEach([this](NowEntity& e) {
-        if (e.isDirty()) {
-          JsonDocument d;
-          e.serializeState(d);
-          if (send(d)) e.clearDirty();
+      // As many dirty entities per frame as fit in MAX_PAYLOAD
+      uint8_t batch[decltype(reg)::MAX];
+      uint8_t n = 0;
+      uint32_t now = clock();
+      if (awaitingStatus(now)) return;
+
+      reg.forEach([&](uint8_t h, NowEntity& e) {
+        if (outbox.busy || !pending(h, e) || !due(h, e, now)) return;
+
+        batch[n++] = h;
+        if (n > 1 && !fits(buildStates(batch, n))) {
+          sendStates(batch, n - 1, now);
+          batch[0] = h;
+          n = outbox.busy ? 0 : 1; // the rest waits for the status
         }
       });
+      if (n) sendStates(batch, n, now);
+      if (outbox.busy) return;
 
-      DiscoveryRequest r;
-      if (dq.pop(r)) {
-        JsonDocument d;
-        r.ent->serializeDiscovery(d);
-        send(d);
+      uint8_t h;
+      if (ds.pop(now, h)) {
+        JsonDocument& d = txDocument();
+        d[K::TYPE] = T::DISCOVERY;
+        d[K::DEVICE_ID] = devId;
+        d[K::HANDLE] = h;
+        if (listenMs) d[K::SLEEPY] = 1;
+        reg.at(h)->serializeDiscovery(d.as<JsonObject>());
+        if (!send(d))
+          ds.push(h, now, 0);
+        else if (outbox.busy)
+          outbox.discovery = h;
       }
     }
 
+    // Downlink answers the last frame, so the window runs from there. A
+    // command received marks its entity dirty, which sends and listens again
+    bool idle(uint32_t now) {
+      if (awaitingStatus(now) || ds.count) return false;
+
+      bool any = false;
+      reg.forEach([&](uint8_t h, NowEntity& e) { any = any || pending(h, e); });
+      return !any && now - lastTxAt >= listenMs;
+    }
+
     void rx(const uint8_t* data, size_t len) {
-      DeserializationError err = deserializeJson(_payload, data, len);
+      if (!len) return;
+
+      _payload.clear();
+      _rxArena.reset();
+
+      DeserializationError err = data[0] == C::MSGPACK_MARKER
+        ? deserializeMsgPack(_payload, data + 1, len - 1)
+        : deserializeJson(_payload, data, len);
       if (err) return;
 
       const char* type = _payload[K::TYPE] | "";
-      const char* id = _payload[K::ID] | "";
+      bool discovery = !strcmp(type, T::DISCOVERY);
+      JsonVariantConst handle = _payload[K::HANDLE];
 
-      if (!strcmp(type, T::DISCOVERY)) {
-        if (auto* e = reg.find(id))
-          dq.push(e);
+      // Broadcast rediscover, everything is announced within the window
+      if (discovery && handle.isNull() && !_payload[K::ID].is<const char*>()) {
+        uint32_t window = _payload[K::WINDOW] | NOWLINK_REDISCOVER_WINDOW_MS;
+        ds.pushAll(reg.n, clock(), jitter(window));
         return;
       }
 
-      if (auto* e = reg.find(id)) {
-        e->handlePayload(_payload);
+      uint8_t h = handle.is<uint8_t>()
+        ? handle.as<uint8_t>()
+        : reg.find(_payload[K::ID] | "");
+
+      NowEntity* e = reg.at(h);
+      if (!e) return;
+
+      if (discovery) {
+        ds.push(h, clock(), jitter(NOWLINK_DISCOVERY_JITTER_MS));
+        return;
       }
+
+      e->handlePayload(_payload);
     }
-  } core;
+  };
+
+  Core mainCore;
+  Core* core = &mainCore;
 }
 
 namespace NowLink {
   void registerEntity(NowEntity* e, bool init_discovery) {
-    core.reg.add(e);
-    if (init_discovery) core.dq.push(e);
+    uint8_t h = core->reg.add(e);
+    if (h != decltype(core->reg)::NO_HANDLE && init_discovery) core->ds.push(h, 0, 0);
+  }
+
+  // Instance is a Core behind a name usable outside this header
+  Instance* create() {
+    return reinterpret_cast<Instance*>(new Core());
+  }
+
+  Instance* select(Instance* instance) {
+    Instance* previous = reinterpret_cast<Instance*>(core);
+    core = instance ? reinterpret_cast<Core*>(instance) : &mainCore;
+    return previous;
   }
 
   void begin(const char* deviceId) {
-    core.devId = deviceId;
+    core->devId = deviceId;
+    core->seedJitter();
+    core->ds.delay(core->clock(), core->jitter(NOWLINK_DISCOVERY_JITTER_MS));
   }
 
   void loop() {
-    core.loop();
+    core->loop();
   }
 
   const char* id() {
-    return core.devId;
+    return core->devId;
   }
 
   void handlePacket(const uint8_t* d, size_t l) {
-    core.rx(d, l);
+    core->rx(d, l);
   }
 
   void setSendCallback(SendCallback cb) {
-    core.sender = cb;
+    core->sender = cb;
+  }
+
+  void setCodec(Codec codec) {
+    core->codec = codec;
+  }
+
+  void setClock(Clock clock) {
+    core->clock = clock ? clock : defaultClock;
+  }
+
+  void setDeliveryTracking(bool on) {
+    core->tracking = on;
+    if (!on) core->outbox.busy = false;
+  }
+
+  void handleSendStatus(bool delivered) {
+    core->outbox.report(delivered);
+  }
+
+  void setSleepy(uint16_t listenMs) {
+    core->listenMs = listenMs;
+  }
+
+  bool readyToSleep() {
+    return core->listenMs && core->idle(core->clock());
   }
 }
 
@@ -162,6 +559,12 @@ public:
   void begin(const char* id){ NowLink::begin(id);}  
   void loop(){ NowLink::loop(); }
   void onSend(NowLink::SendCallback cb){ NowLink::setSendCallback(cb);}  
+  void setCodec(NowLink::Codec c){ NowLink::setCodec(c);}  
+  void setClock(NowLink::Clock c){ NowLink::setClock(c);}  
+  void setDeliveryTracking(bool on){ NowLink::setDeliveryTracking(on);}  
+  void handleSendStatus(bool ok){ NowLink::handleSendStatus(ok);}  
+  void setSleepy(uint16_t listenMs){ NowLink::setSleepy(listenMs);}  
+  bool readyToSleep(){ return NowLink::readyToSleep(); }
   void handlePacket(const uint8_t* d,size_t l){ NowLink::handlePacket(d,l);}  
   const char* id(){ return NowLink::id(); }
 };
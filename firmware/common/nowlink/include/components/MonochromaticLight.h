@@ -20,15 +20,12 @@ public:
   const char* id()       const override { return _id; }
   const char* platform() const override { return PLATFORM; }
 
-  void serializeDiscovery(JsonDocument& doc) const override {
-    doc[K::TYPE] = T::DISCOVERY;
+  void serializeDiscovery(JsonObject doc) const override {
     _fillCommon(doc);
     doc[K::SUPPORTED_COLOR_MODES] = "brightness";
   }
 
-  void serializeState(JsonDocument& doc) const override {
-    doc[K::TYPE] = T::HYBRID;
-    _fillCommon(doc);
+  void serializeState(JsonObject doc) const override {
     doc[K::STATE]     = _on ? "ON" : "OFF";
     doc[K::BRIGHTNESS] = _brightness;
   }
@@ -86,8 +83,7 @@ public:
   ChangeCallback onChange = nullptr;
 
 private:
-  void _fillCommon(JsonDocument& doc) const {
-    doc[K::DEVICE_ID] = NowLink::id();
+  void _fillCommon(JsonObject doc) const {
     doc[K::PLATFORM]  = platform();
     doc[K::ID]        = _id;
   }
@@ -19,13 +19,10 @@ public:
   const char* id()       const override { return _id; }
   const char* platform() const override { return "light"; }
 
-  void serializeDiscovery(JsonDocument& doc) const override {
-    doc[K::TYPE] = T::DISCOVERY;
+  void serializeDiscovery(JsonObject doc) const override {
     _fillCommon(doc);
   }
-  void serializeState(JsonDocument& doc) const override {
-    doc[K::TYPE] = T::HYBRID;
-    _fillCommon(doc);
+  void serializeState(JsonObject doc) const override {
     doc[K::STATE] = _state ? "ON" : "OFF";
   }
 
@@ -46,8 +43,7 @@ public:
   ChangeCallback onChange = nullptr;
 
 private:
-  void _fillCommon(JsonDocument& doc) const {
-    doc[K::DEVICE_ID] = NowLink::id();
+  void _fillCommon(JsonObject doc) const {
     doc[K::PLATFORM]  = platform();
     doc[K::ID]        = _id;
   }
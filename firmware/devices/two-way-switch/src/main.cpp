@@ -18,6 +18,9 @@ NowSwitch       led("led_switch");
 bool sendCb(const uint8_t* data, size_t len){
   return quickEspNow.send(GW, data, len) == 0; 
 }
+void onSent(uint8_t* mac, uint8_t status){
+  Now.handleSendStatus(status == 0);
+}
 void onRx(const uint8_t* mac, const uint8_t* data, uint8_t len, int rssi, bool is_broadcast){
   Now.handlePacket(data,len); 
 }
@@ -31,9 +34,12 @@ void setup(){
   
   quickEspNow.begin(ESPNOW_WIFI_CHANNEL);
   quickEspNow.onDataRcvd(onRx);
+  quickEspNow.onDataSent(onSent);
   
   Now.begin(DEVICE_ID);
   Now.onSend(sendCb);
+  Now.setCodec(NowLink::CODEC_MSGPACK);
+  Now.setDeliveryTracking(true);
   
   led.onChange = [](bool s){ digitalWrite(LED_PIN, !s); };
 
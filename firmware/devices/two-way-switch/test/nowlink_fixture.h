@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <NowLink.h>
+
+// What the native NowLink suites share: a device on a fake clock whose frames
+// land in `frames`. Suites overriding NOWLINK_* limits define them before
+// including this.
+
+inline std::vector<std::string> frames;
+inline uint32_t ms = 0;
+inline bool radioUp = true; // false makes every send fail
+
+inline uint32_t fakeClock() { return ms; }
+
+inline bool capture(const uint8_t* data, size_t len) {
+  if (!radioUp) return false;
+  frames.emplace_back((const char*)data, len);
+  return true;
+}
+
+inline bool contains(const std::string& s, const char* needle) {
+  return s.find(needle) != std::string::npos;
+}
+
+inline size_t count(const std::string& s, const char* needle) {
+  size_t n = 0;
+  for (size_t at = s.find(needle); at != std::string::npos; at = s.find(needle, at + 1)) ++n;
+  return n;
+}
+
+inline void feed(const char* json) {
+  NowLink::handlePacket((const uint8_t*)json, strlen(json));
+}
+
+// Runs loop() every ms for a while
+inline void run(uint32_t duration) {
+  for (uint32_t end = ms + duration; ms != end; ++ms) NowLink::loop();
+}
+
+// begin() on the fake clock with sends captured, for setUp() to configure
+inline void beginDevice() {
+  radioUp = true;
+  NowLink::setClock(fakeClock);
+  NowLink::begin("two_way_device");
+  NowLink::setSendCallback(capture);
+}
+
+// Sends what begin() left dirty, lets throttles and pacing run out over
+// `duration` ms and forgets the frames
+inline void settle(uint32_t duration = 0) {
+  NowLink::loop();
+  run(duration);
+  frames.clear();
+}
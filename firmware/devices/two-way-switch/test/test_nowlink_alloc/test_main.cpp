@@ -0,0 +1,120 @@
+// Heap allocations on the NowLink send and receive paths, native only:
+//
+//   pio test -e native
+//
+// malloc/realloc/calloc are wrapped by the linker (see [env:native]) and
+// operator new is replaced below, every heap request bumps `allocations`.
+
+#include <unity.h>
+
+#include <stdlib.h>
+#include <new>
+
+#include <NowLink.h>
+#include <components/Switch.h>
+#include <components/MonochromaticLight.h>
+
+static size_t allocations = 0;
+
+extern "C" {
+  void* __real_malloc(size_t size);
+  void* __real_realloc(void* ptr, size_t size);
+  void* __real_calloc(size_t n, size_t size);
+
+  void* __wrap_malloc(size_t size) { ++allocations; return __real_malloc(size); }
+  void* __wrap_realloc(void* ptr, size_t size) { ++allocations; return __real_realloc(ptr, size); }
+  void* __wrap_calloc(size_t n, size_t size) { ++allocations; return __real_calloc(n, size); }
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* p = __real_malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+NowSwitch sw("led_switch", true);
+NowMonochromaticLight lamp("desk_lamp", true);
+
+static size_t sent = 0;
+static uint32_t ms = 0;
+
+static uint32_t fakeClock() { return ms; }
+
+static bool countSend(const uint8_t*, size_t) {
+  ++sent;
+  return true;
+}
+
+static void feed(const char* json) {
+  NowLink::handlePacket((const uint8_t*)json, strlen(json));
+}
+
+void setUp() {
+  NowLink::setClock(fakeClock);
+  NowLink::begin("test_device");
+  NowLink::setSendCallback(countSend);
+  NowLink::setCodec(NowLink::CODEC_JSON);
+  for (int i = 0; i < 3; ++i) { // first discovery and state out of the way
+    ms += 1000;
+    NowLink::loop();
+  }
+  sent = 0;
+}
+
+void tearDown() {}
+
+static void assertStateSendsDoNotAllocate(NowLink::Codec codec) {
+  NowLink::setCodec(codec);
+
+  size_t before = allocations;
+  for (int i = 0; i < 100; ++i) {
+    sw.toggle();
+    lamp.setBrightness(i + 1);
+    NowLink::loop();
+  }
+
+  TEST_ASSERT_EQUAL(100, sent); // both states share a frame
+  TEST_ASSERT_EQUAL(0, allocations - before);
+}
+
+void test_json_state_sends_do_not_allocate() {
+  assertStateSendsDoNotAllocate(NowLink::CODEC_JSON);
+}
+
+void test_msgpack_state_sends_do_not_allocate() {
+  assertStateSendsDoNotAllocate(NowLink::CODEC_MSGPACK);
+}
+
+void test_discovery_does_not_allocate() {
+  size_t before = allocations;
+  for (int i = 0; i < 50; ++i) {
+    feed("{\".t\":\"d\",\"id\":\"desk_lamp\"}");
+    ms += 1000; // past the jitter
+    NowLink::loop();
+  }
+
+  TEST_ASSERT_EQUAL(50, sent);
+  TEST_ASSERT_EQUAL(0, allocations - before);
+}
+
+void test_commands_do_not_allocate() {
+  size_t before = allocations;
+  for (int i = 0; i < 50; ++i) {
+    feed(i % 2 ? "{\"n\":0,\"stat\":\"ON\"}" : "{\"n\":0,\"stat\":\"OFF\"}");
+    NowLink::loop();
+  }
+
+  TEST_ASSERT_EQUAL(0, allocations - before);
+  TEST_ASSERT_TRUE(sent > 0);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_json_state_sends_do_not_allocate);
+  RUN_TEST(test_msgpack_state_sends_do_not_allocate);
+  RUN_TEST(test_discovery_does_not_allocate);
+  RUN_TEST(test_commands_do_not_allocate);
+  return UNITY_END();
+}
@@ -0,0 +1,76 @@
+// Dirty entity states packed into shared frames, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+// States go by handle and are short, it takes more than the default ten
+// entities to overflow a frame
+#define NOWLINK_MAX_ENTITIES 16
+#include "../nowlink_fixture.h"
+
+#include <components/BinarySensor.h>
+#include <components/Switch.h>
+
+NowBinarySensor btn("flash_button");
+NowSwitch led("led_switch");
+NowSwitch relays[12] = {
+  NowSwitch("relay_1"), NowSwitch("relay_2"), NowSwitch("relay_3"), NowSwitch("relay_4"),
+  NowSwitch("relay_5"), NowSwitch("relay_6"), NowSwitch("relay_7"), NowSwitch("relay_8"),
+  NowSwitch("relay_9"), NowSwitch("relay_10"), NowSwitch("relay_11"), NowSwitch("relay_12"),
+};
+
+void setUp() {
+  beginDevice();
+  settle();
+}
+
+void tearDown() {}
+
+void test_single_state_is_a_plain_state_frame() {
+  led.toggle();
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\".t\":\"s\",\"dev_id\":\"two_way_device\",\"n\":1,\"stat\":\"ON\"}",
+    frames[0].c_str());
+}
+
+void test_dirty_states_share_a_frame() {
+  btn.setState(!btn.state());
+  led.toggle();
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_EQUAL(1, count(frames[0], "\"dev_id\""));
+  TEST_ASSERT_EQUAL(1, count(frames[0], "\".t\":\"b\""));
+  TEST_ASSERT_EQUAL(1, count(frames[0], "\"n\":0"));
+  TEST_ASSERT_EQUAL(1, count(frames[0], "\"n\":1"));
+}
+
+void test_batches_split_at_the_payload_limit() {
+  btn.setState(!btn.state());
+  led.toggle();
+  for (NowSwitch& r : relays) r.toggle();
+  NowLink::loop();
+
+  TEST_ASSERT_TRUE(frames.size() > 1);
+
+  size_t states = 0;
+  for (const std::string& f : frames) {
+    TEST_ASSERT_TRUE(f.size() <= 250);
+    TEST_ASSERT_EQUAL(1, count(f, "\"dev_id\""));
+    states += count(f, "\"n\":");
+  }
+  TEST_ASSERT_EQUAL(14, states);
+  TEST_ASSERT_FALSE(relays[11].isDirty());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_state_is_a_plain_state_frame);
+  RUN_TEST(test_dirty_states_share_a_frame);
+  RUN_TEST(test_batches_split_at_the_payload_limit);
+  return UNITY_END();
+}
@@ -0,0 +1,87 @@
+// Paced discovery announcements against a fake clock, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/Switch.h>
+
+NowSwitch switches[7] = {
+  NowSwitch("switch_1"), NowSwitch("switch_2"), NowSwitch("switch_3"), NowSwitch("switch_4"),
+  NowSwitch("switch_5"), NowSwitch("switch_6"), NowSwitch("switch_7"),
+};
+
+void setUp() {
+  beginDevice();
+  settle(5000);
+}
+
+void tearDown() {}
+
+void test_repeated_requests_collapse() {
+  feed("{\".t\":\"d\",\"n\":0}");
+  feed("{\".t\":\"d\",\"n\":0}");
+  feed("{\".t\":\"d\",\"id\":\"switch_1\"}");
+  run(2000);
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+}
+
+void test_nothing_is_dropped() {
+  for (const char* req : {
+         "{\".t\":\"d\",\"n\":0}", "{\".t\":\"d\",\"n\":1}", "{\".t\":\"d\",\"n\":2}",
+         "{\".t\":\"d\",\"n\":3}", "{\".t\":\"d\",\"n\":4}", "{\".t\":\"d\",\"n\":5}",
+         "{\".t\":\"d\",\"n\":6}" })
+    feed(req);
+  run(2000);
+
+  TEST_ASSERT_EQUAL(7, frames.size());
+}
+
+void test_announcements_are_paced() {
+  feed("{\".t\":\"d\",\"w\":0}");
+  NowLink::loop();
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+
+  run(NOWLINK_DISCOVERY_INTERVAL_MS + 1);
+  TEST_ASSERT_EQUAL(2, frames.size());
+
+  run(5 * NOWLINK_DISCOVERY_INTERVAL_MS);
+  TEST_ASSERT_EQUAL(7, frames.size());
+}
+
+void test_rediscover_starts_within_the_window() {
+  feed("{\".t\":\"d\",\"w\":1000}");
+  uint32_t start = ms;
+  while (frames.empty() && ms - start < 2000) run(1);
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(ms - start <= 1000);
+
+  run(2000);
+  TEST_ASSERT_EQUAL(7, frames.size());
+}
+
+void test_failed_announcement_is_kept() {
+  radioUp = false;
+  feed("{\".t\":\"d\",\"n\":3}");
+  run(1000);
+  TEST_ASSERT_EQUAL(0, frames.size());
+
+  radioUp = true;
+  run(1000);
+  TEST_ASSERT_EQUAL(1, frames.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeated_requests_collapse);
+  RUN_TEST(test_nothing_is_dropped);
+  RUN_TEST(test_announcements_are_paced);
+  RUN_TEST(test_rediscover_starts_within_the_window);
+  RUN_TEST(test_failed_announcement_is_kept);
+  return UNITY_END();
+}
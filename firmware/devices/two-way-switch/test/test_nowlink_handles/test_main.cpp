@@ -0,0 +1,66 @@
+// Entities addressed by their numeric handle, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/BinarySensor.h>
+#include <components/MonochromaticLight.h>
+#include <components/Switch.h>
+
+NowBinarySensor btn("flash_button");
+NowSwitch led("led_switch");
+NowMonochromaticLight lamp("desk_lamp");
+
+void setUp() {
+  beginDevice();
+  settle();
+}
+
+void tearDown() {}
+
+void test_discovery_announces_the_handle() {
+  feed("{\".t\":\"d\",\"n\":2}");
+  ms += NOWLINK_DISCOVERY_JITTER_MS;
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_EQUAL_STRING(
+    "{\".t\":\"d\",\"dev_id\":\"two_way_device\",\"n\":2,\"p\":\"light\",\"id\":\"desk_lamp\",\"sup_clrm\":\"brightness\"}",
+    frames[0].c_str());
+}
+
+void test_commands_by_handle() {
+  feed("{\"n\":2,\"stat\":\"ON\",\"br\":40}");
+
+  TEST_ASSERT_TRUE(lamp.isOn());
+  TEST_ASSERT_EQUAL(40, lamp.brightness());
+  TEST_ASSERT_FALSE(led.isDirty());
+}
+
+void test_commands_by_id_still_work() {
+  bool on = led.state();
+  feed(on ? "{\"id\":\"led_switch\",\"stat\":\"OFF\"}" : "{\"id\":\"led_switch\",\"stat\":\"ON\"}");
+
+  TEST_ASSERT_EQUAL(!on, led.state());
+}
+
+void test_unknown_handles_are_dropped() {
+  feed("{\"n\":3,\"stat\":\"ON\"}");
+  feed("{\".t\":\"d\",\"n\":200}");
+  ms += NOWLINK_DISCOVERY_JITTER_MS;
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(0, frames.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_discovery_announces_the_handle);
+  RUN_TEST(test_commands_by_handle);
+  RUN_TEST(test_commands_by_id_still_work);
+  RUN_TEST(test_unknown_handles_are_dropped);
+  return UNITY_END();
+}
@@ -0,0 +1,75 @@
+// Several devices in one process, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/BinarySensor.h>
+#include <components/Switch.h>
+
+NowSwitch led("led_switch");
+
+static NowLink::Instance* other;
+static NowBinarySensor* door;
+
+void setUp() {
+  frames.clear();
+}
+
+void tearDown() {
+  NowLink::select(nullptr);
+}
+
+void test_entities_register_with_the_selected_instance() {
+  other = NowLink::create();
+  NowLink::Instance* previous = NowLink::select(other);
+  door = new NowBinarySensor("door");
+  NowLink::begin("other_device");
+  NowLink::setSendCallback(capture);
+
+  // The entity takes handle 0 of its own registry
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], "\"dev_id\":\"other_device\""));
+  TEST_ASSERT_TRUE(contains(frames[0], "\"n\":0"));
+  TEST_ASSERT_EQUAL_STRING("other_device", NowLink::id());
+
+  NowLink::select(previous);
+  TEST_ASSERT_EQUAL_STRING("main_device", NowLink::id());
+}
+
+void test_calls_reach_the_selected_instance_only() {
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], "\"dev_id\":\"main_device\""));
+
+  // Same handle, other device
+  NowLink::select(other);
+  feed("{\"n\":0,\"stat\":\"ON\"}");
+  TEST_ASSERT_FALSE(led.state());
+
+  frames.clear();
+  door->setState(true);
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], "\"dev_id\":\"other_device\""));
+}
+
+void test_select_null_goes_back_to_the_default() {
+  NowLink::select(other);
+  TEST_ASSERT_TRUE(NowLink::select(nullptr) == other);
+  TEST_ASSERT_EQUAL_STRING("main_device", NowLink::id());
+}
+
+int main(int, char**) {
+  NowLink::begin("main_device");
+  NowLink::setSendCallback(capture);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_entities_register_with_the_selected_instance);
+  RUN_TEST(test_calls_reach_the_selected_instance_only);
+  RUN_TEST(test_select_null_goes_back_to_the_default);
+  return UNITY_END();
+}
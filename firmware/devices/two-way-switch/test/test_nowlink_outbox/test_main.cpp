@@ -0,0 +1,117 @@
+// States kept pending until the radio reports them delivered, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/MonochromaticLight.h>
+#include <components/Switch.h>
+
+NowSwitch led("led_switch");
+NowMonochromaticLight lamp("desk_lamp");
+
+static void deliver() {
+  NowLink::handleSendStatus(true);
+  NowLink::loop();
+}
+
+void setUp() {
+  beginDevice();
+  NowLink::setDeliveryTracking(true);
+
+  // everything starts dirty
+  NowLink::loop();
+  deliver();
+  frames.clear();
+  ms += 5000;
+}
+
+void tearDown() {
+  deliver();
+}
+
+void test_delivered_states_are_not_sent_again() {
+  led.toggle();
+  NowLink::loop();
+  deliver();
+  ms += 5000;
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+}
+
+void test_one_frame_on_air_at_a_time() {
+  led.toggle();
+  NowLink::loop();
+  lamp.toggle();
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+
+  deliver();
+  TEST_ASSERT_EQUAL(2, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[1], "\"n\":1"));
+}
+
+void test_failed_state_is_retried_with_the_newest_value() {
+  led.toggle();
+  NowLink::loop();
+  NowLink::handleSendStatus(false);
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+
+  led.toggle();
+  ms += NOWLINK_RETRY_BASE_MS;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[1], led.state() ? "\"stat\":\"ON\"" : "\"stat\":\"OFF\""));
+
+  deliver();
+  ms += 5000;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+}
+
+void test_missing_status_counts_as_failure() {
+  led.toggle();
+  NowLink::loop();
+  ms += NOWLINK_ACK_TIMEOUT_MS + 1;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+
+  ms += NOWLINK_RETRY_BASE_MS;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+}
+
+void test_backoff_doubles() {
+  led.toggle();
+  NowLink::loop();
+  NowLink::handleSendStatus(false);
+  NowLink::loop();
+
+  ms += NOWLINK_RETRY_BASE_MS;
+  NowLink::loop();
+  NowLink::handleSendStatus(false);
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+
+  ms += NOWLINK_RETRY_BASE_MS;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+
+  ms += NOWLINK_RETRY_BASE_MS;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(3, frames.size());
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_delivered_states_are_not_sent_again);
+  RUN_TEST(test_one_frame_on_air_at_a_time);
+  RUN_TEST(test_failed_state_is_retried_with_the_newest_value);
+  RUN_TEST(test_missing_status_counts_as_failure);
+  RUN_TEST(test_backoff_doubles);
+  return UNITY_END();
+}
@@ -0,0 +1,98 @@
+// Sleepy device wakes against a fake clock, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/MonochromaticLight.h>
+#include <components/Switch.h>
+
+#define LISTEN_MS 50
+
+NowSwitch led("led_switch");
+NowMonochromaticLight lamp("desk_lamp");
+
+// Runs loop() every ms until the device may sleep, returns the time awake
+static uint32_t wake() {
+  uint32_t start = ms;
+  while (!NowLink::readyToSleep() && ms - start < 5000) {
+    NowLink::loop();
+    ++ms;
+  }
+  return ms - start;
+}
+
+void setUp() {
+  beginDevice();
+  NowLink::setSleepy(LISTEN_MS);
+  wake();
+  frames.clear();
+}
+
+void tearDown() {}
+
+void test_discovery_flags_the_device() {
+  feed("{\".t\":\"d\",\"n\":0}");
+  wake();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], "\"slp\":1"));
+}
+
+void test_wake_sends_one_batch_then_listens() {
+  led.toggle();
+  lamp.toggle();
+  uint32_t awake = wake();
+
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], "\".t\":\"b\""));
+  TEST_ASSERT_TRUE(awake >= LISTEN_MS);
+  TEST_ASSERT_TRUE(awake < LISTEN_MS + 10);
+}
+
+void test_downlink_extends_the_wake() {
+  led.toggle();
+  NowLink::loop();
+  ms += LISTEN_MS - 1;
+  feed(led.state() ? "{\"n\":0,\"stat\":\"OFF\"}" : "{\"n\":0,\"stat\":\"ON\"}");
+  TEST_ASSERT_FALSE(NowLink::readyToSleep());
+
+  wake();
+  TEST_ASSERT_EQUAL(2, frames.size());
+}
+
+void test_undelivered_state_keeps_it_awake() {
+  NowLink::setDeliveryTracking(true);
+  led.toggle();
+  NowLink::loop();
+  ms += LISTEN_MS;
+  TEST_ASSERT_FALSE(NowLink::readyToSleep());
+
+  NowLink::handleSendStatus(true);
+  TEST_ASSERT_TRUE(NowLink::readyToSleep());
+  NowLink::setDeliveryTracking(false);
+}
+
+void test_off_by_default() {
+  NowLink::setSleepy(0);
+  ms += 5000;
+  TEST_ASSERT_FALSE(NowLink::readyToSleep());
+
+  feed("{\".t\":\"d\",\"n\":1}");
+  ms += NOWLINK_DISCOVERY_JITTER_MS;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_FALSE(contains(frames[0], "slp"));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_discovery_flags_the_device);
+  RUN_TEST(test_wake_sends_one_batch_then_listens);
+  RUN_TEST(test_downlink_extends_the_wake);
+  RUN_TEST(test_undelivered_state_keeps_it_awake);
+  RUN_TEST(test_off_by_default);
+  return UNITY_END();
+}
@@ -0,0 +1,81 @@
+// Per entity publish throttling against a fake clock, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "../nowlink_fixture.h"
+
+#include <components/MonochromaticLight.h>
+#include <components/Switch.h>
+
+NowMonochromaticLight lamp("desk_lamp");
+NowSwitch sw("led_switch");
+NowSwitch burst("burst_switch");
+
+void setUp() {
+  beginDevice();
+  lamp.throttle(100);
+  burst.throttle(0, 50);
+  settle(2000);
+}
+
+void tearDown() {}
+
+void test_min_interval_sends_only_the_newest_value() {
+  lamp.set(true, 10);
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+
+  ms += 10;
+  lamp.setBrightness(20);
+  NowLink::loop();
+  ms += 10;
+  lamp.setBrightness(30);
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(lamp.isDirty());
+
+  ms += 80;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(2, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[1], "\"br\":30"));
+  TEST_ASSERT_FALSE(lamp.isDirty());
+}
+
+void test_unthrottled_entities_are_not_held_back() {
+  lamp.setBrightness(lamp.brightness() + 1);
+  NowLink::loop();
+  ms += 10;
+  lamp.setBrightness(lamp.brightness() + 1);
+  sw.toggle();
+  NowLink::loop();
+
+  TEST_ASSERT_EQUAL(2, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[1], "\"n\":1"));
+  TEST_ASSERT_FALSE(contains(frames[1], "\"n\":0"));
+}
+
+void test_max_latency_collapses_a_burst() {
+  bool before = burst.state();
+  burst.toggle();
+  NowLink::loop();
+  ms += 20;
+  burst.toggle();
+  burst.toggle();
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(0, frames.size());
+
+  ms += 30;
+  NowLink::loop();
+  TEST_ASSERT_EQUAL(1, frames.size());
+  TEST_ASSERT_TRUE(contains(frames[0], before ? "\"stat\":\"OFF\"" : "\"stat\":\"ON\""));
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_min_interval_sends_only_the_newest_value);
+  RUN_TEST(test_unthrottled_entities_are_not_held_back);
+  RUN_TEST(test_max_latency_collapses_a_burst);
+  return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include "Corruption.h"
+
+#include "serial/PacketDecoder.h"
+
+namespace {
+  constexpr uint8_t MAC[6] = {0x8c, 0xaa, 0xb5, 0x52, 0xcf, 0x10};
+
+  uint32_t next(uint32_t& seed) {
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+  }
+
+  uint32_t below(uint32_t& seed, uint32_t n) {
+    return next(seed) % n;
+  }
+
+  uint8_t randomByte(uint32_t& seed) {
+    switch (below(seed, 8)) {
+      case 0:
+      case 1:  return PacketDecoder::SYNC;
+      case 2:  return 0x00;
+      default: return next(seed);
+    }
+  }
+
+  // V1 ESPNOW_TX header claiming `len` payload bytes, no CRC
+  void appendV1Header(FrameStreams::Bytes& out, uint8_t len) {
+    out.insert(out.end(), { PacketDecoder::SYNC, PacketDecoder::VERSION, PacketDecoder::TYPE_ESPNOW_TX });
+    out.insert(out.end(), MAC, MAC + 6);
+    out.push_back(0);
+    out.push_back(len);
+  }
+
+  // V2 ESPNOW_TX whose LEN disagrees with the payload, CRC and COBS intact
+  void appendV2BadLength(FrameStreams::Bytes& out, uint32_t& seed) {
+    uint8_t tdata[6 + 1 + 1 + 16];
+    memcpy(tdata, MAC, 6);
+    tdata[6] = 0;
+    tdata[7] = 16 + 1 + below(seed, 200);
+    for (uint8_t i = 8; i < sizeof(tdata); ++i) tdata[i] = randomByte(seed);
+    FrameStreams::appendFrame(out, PacketDecoder::TYPE_ESPNOW_TX, tdata, sizeof(tdata), PacketDecoder::VERSION_2);
+  }
+
+  void appendFault(FrameStreams::Bytes& out, Corruption::Kind kind, uint8_t version, uint32_t& seed) {
+    switch (kind) {
+      case Corruption::NOISE: {
+        uint8_t n = 1 + below(seed, 32);
+        for (uint8_t i = 0; i < n; ++i) out.push_back(randomByte(seed));
+        break;
+      }
+
+      case Corruption::TRUNCATED: {
+        FrameStreams::Bytes frame;
+        Corruption::appendFrame(frame, UINT32_MAX, version, seed);
+        out.insert(out.end(), frame.begin(), frame.begin() + 1 + below(seed, frame.size() - 1));
+        break;
+      }
+
+      case Corruption::BAD_CRC: {
+        size_t at = out.size();
+        Corruption::appendFrame(out, UINT32_MAX, version, seed);
+
+        // V1: the CRC byte. V2: any byte but the delimiter, kept non zero
+        size_t i = version == PacketDecoder::VERSION_2 ? at + below(seed, out.size() - at - 1) : out.size() - 1;
+        uint8_t flipped;
+        do flipped = out[i] ^ (1 + below(seed, 255));
+        while (version == PacketDecoder::VERSION_2 && flipped == 0);
+        out[i] = flipped;
+        break;
+      }
+
+      case Corruption::STRAY_SYNC: {
+        const uint8_t prefix[3] = { PacketDecoder::SYNC, PacketDecoder::VERSION, PacketDecoder::TYPE_ESPNOW_TX };
+        out.insert(out.end(), prefix, prefix + 1 + below(seed, 3));
+        break;
+      }
+
+      case Corruption::OVERSIZED_LEN:
+        if (version == PacketDecoder::VERSION_2) {
+          appendV2BadLength(out, seed);
+        } else {
+          // Above the 250 byte payload limit, or fine but cut short
+          bool illegal = below(seed, 2);
+          uint8_t len = illegal ? 251 + below(seed, 5) : 200 + below(seed, 51);
+          appendV1Header(out, len);
+          uint8_t n = below(seed, 40);
+          for (uint8_t i = 0; i < n; ++i) out.push_back(randomByte(seed));
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+namespace Corruption {
+  const char* name(Kind kind) {
+    switch (kind) {
+      case NOISE:         return "noise";
+      case TRUNCATED:     return "truncated";
+      case BAD_CRC:       return "bad_crc";
+      case STRAY_SYNC:    return "stray_sync";
+      case OVERSIZED_LEN: return "oversized_len";
+      default:            return "?";
+    }
+  }
+
+  void appendFrame(FrameStreams::Bytes& out, uint32_t index, uint8_t version, uint32_t& seed) {
+    uint8_t payload[64];
+    uint8_t len = 4 + below(seed, sizeof(payload) - 4 + 1);
+
+    for (uint8_t i = 0; i < 4; ++i) payload[i] = index >> (8 * i);
+    for (uint8_t i = 4; i < len; ++i) payload[i] = below(seed, 4) ? next(seed) : PacketDecoder::SYNC;
+
+    if (version == PacketDecoder::VERSION_2) FrameStreams::appendEspNowTxV2(out, MAC, payload, len, index);
+    else FrameStreams::appendEspNowTx(out, MAC, payload, len, index);
+  }
+
+  Stream build(Kind kind, size_t events, uint8_t version, uint32_t seed, uint8_t between) {
+    Stream s;
+    uint32_t index = 0;
+
+    auto appendValid = [&] {
+      for (uint8_t i = 0; i < between; ++i) {
+        size_t at = s.bytes.size();
+        appendFrame(s.bytes, index++, version, seed);
+        s.frames.push_back({ at, s.bytes.size() });
+      }
+    };
+
+    appendValid();
+    for (size_t e = 0; e < events; ++e) {
+      s.events.push_back({ s.bytes.size(), index });
+      appendFault(s.bytes, kind, version, seed);
+      appendValid();
+    }
+    return s;
+  }
+}
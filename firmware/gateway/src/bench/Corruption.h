@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+#include "FrameStreams.h"
+
+// Host -> gateway streams with line faults between valid ESPNOW_TX frames,
+// used by the resync benchmark. Valid frames carry their index in the first
+// four payload bytes and plenty of 0xAA (the V1 sync byte) after it.
+namespace Corruption {
+  enum Kind : uint8_t {
+    NOISE,         // 1-32 random bytes, rich in 0xAA and 0x00
+    TRUNCATED,     // a frame cut short, the rest never sent
+    BAD_CRC,       // a frame with one byte flipped
+    STRAY_SYNC,    // a lone sync, sync + version or sync + version + type
+    OVERSIZED_LEN, // LEN larger than the data that follows, or than allowed
+    KIND_COUNT
+  };
+
+  const char* name(Kind kind);
+
+  // A valid frame, by index
+  struct Frame {
+    size_t at;
+    size_t end;
+  };
+
+  struct Event {
+    size_t at;          // first corrupt byte
+    uint32_t nextFrame; // the valid frame following it
+  };
+
+  struct Stream {
+    FrameStreams::Bytes bytes;
+    std::vector<Frame> frames;
+    std::vector<Event> events;
+  };
+
+  // `events` faults of one kind, each after `between` valid frames
+  Stream build(Kind kind, size_t events, uint8_t version, uint32_t seed, uint8_t between = 3);
+
+  // One valid ESPNOW_TX carrying `index`, as build() lays them out
+  void appendFrame(FrameStreams::Bytes& out, uint32_t index, uint8_t version, uint32_t& seed);
+}
@@ -0,0 +1,115 @@
+#include "FrameStreams.h"
+
+#include <stdio.h>
+
+#include "serial/PacketDecoder.h"
+#include "serial/Crc16.h"
+
+namespace {
+  constexpr uint8_t DEVICE_MAC[6]    = {0x8c, 0xaa, 0xb5, 0x52, 0xcf, 0x10};
+  constexpr uint8_t BROADCAST_MAC[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+  void appendString(FrameStreams::Bytes& out, const uint8_t mac[6], const char* json) {
+    FrameStreams::appendEspNowTx(out, mac, (const uint8_t*)json, strlen(json));
+  }
+}
+
+namespace FrameStreams {
+  void appendFrame(Bytes& out, uint8_t type, const uint8_t* tdata, size_t len, uint8_t version) {
+    if (version != PacketDecoder::VERSION_2) {
+      uint8_t crc = PacketDecoder::VERSION ^ type;
+      out.push_back(PacketDecoder::SYNC);
+      out.push_back(PacketDecoder::VERSION);
+      out.push_back(type);
+      for (size_t i = 0; i < len; ++i) { out.push_back(tdata[i]); crc ^= tdata[i]; }
+      out.push_back(crc);
+      return;
+    }
+
+    Bytes raw = { PacketDecoder::VERSION_2, type };
+    raw.insert(raw.end(), tdata, tdata + len);
+
+    uint16_t crc = Crc16::update(Crc16::INIT, raw.data(), raw.size());
+    raw.push_back(crc & 0xFF);
+    raw.push_back(crc >> 8);
+
+    // COBS, same block rules as Cobs::Writer
+    size_t codeAt = out.size();
+    bool afterFullBlock = false;
+    out.push_back(1);
+    for (uint8_t b : raw) {
+      if (b != 0) {
+        out.push_back(b);
+        afterFullBlock = false;
+        if (++out[codeAt] != 0xFF) continue;
+        afterFullBlock = true;
+      }
+      codeAt = out.size();
+      out.push_back(1);
+    }
+    if (afterFullBlock) out.pop_back();
+    out.push_back(0);
+  }
+
+  void appendEspNowTx(Bytes& out, const uint8_t mac[6], const uint8_t* payload, uint8_t len, uint8_t seq) {
+    uint8_t tdata[6 + 1 + 1 + 255];
+    memcpy(tdata, mac, 6);
+    tdata[6] = seq;
+    tdata[7] = len;
+    memcpy(tdata + 8, payload, len);
+    appendFrame(out, PacketDecoder::TYPE_ESPNOW_TX, tdata, 8 + len);
+  }
+
+  void appendEspNowTxV2(Bytes& out, const uint8_t mac[6], const uint8_t* payload, uint8_t len, uint8_t seq) {
+    uint8_t tdata[6 + 1 + 1 + 255];
+    memcpy(tdata, mac, 6);
+    tdata[6] = seq;
+    tdata[7] = len;
+    memcpy(tdata + 8, payload, len);
+    appendFrame(out, PacketDecoder::TYPE_ESPNOW_TX, tdata, 8 + len, PacketDecoder::VERSION_2);
+  }
+
+  Bytes synthetic(uint8_t len, size_t frames, uint32_t seed, uint8_t version) {
+    Bytes out;
+    out.reserve(frames * (len + 11));
+
+    uint8_t payload[256];
+    for (size_t f = 0; f < frames; ++f) {
+      for (uint8_t i = 0; i < len; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        payload[i] = seed >> 16;
+      }
+      if (version == PacketDecoder::VERSION_2) appendEspNowTxV2(out, DEVICE_MAC, payload, len, f);
+      else appendEspNowTx(out, DEVICE_MAC, payload, len, f);
+    }
+    return out;
+  }
+
+  Bytes typical(size_t rounds) {
+    // Same shapes as the host sends (see src/entities and src/helpers/wizmote.ts)
+    static const uint8_t wizmote[13] = {0x81, 0x02, 0x00, 0x00, 0x00, 0x32, 0x09, 0x01, 90, 0, 0, 0, 0};
+
+    Bytes out;
+    for (size_t r = 0; r < rounds; ++r) {
+      appendString(out, DEVICE_MAC, "{\".t\":\"d\",\"id\":\"led_switch\"}");
+      appendString(out, DEVICE_MAC, "{\"id\":\"led_switch\",\"stat\":\"ON\"}");
+      appendString(out, DEVICE_MAC, "{\"id\":\"led_switch\",\"stat\":\"OFF\"}");
+      appendString(out, DEVICE_MAC, "{\"id\":\"desk_lamp\",\"stat\":\"ON\",\"br\":180}");
+      appendEspNowTx(out, BROADCAST_MAC, wizmote, sizeof(wizmote));
+    }
+    return out;
+  }
+
+  bool load(const char* path, Bytes& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+      out.insert(out.end(), chunk, chunk + n);
+
+    fclose(f);
+    return true;
+  }
+}
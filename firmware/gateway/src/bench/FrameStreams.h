@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <vector>
+
+// Builders for host -> gateway byte streams used by the native benchmarks.
+namespace FrameStreams {
+  using Bytes = std::vector<uint8_t>;
+
+  // Appends one frame of any host -> gateway type, V1 or V2 framing
+  void appendFrame(Bytes& out, uint8_t type, const uint8_t* tdata, size_t len, uint8_t version = 1);
+
+  // Appends one V1 ESPNOW_TX frame (as the host encoder would emit it)
+  void appendEspNowTx(Bytes& out, const uint8_t mac[6], const uint8_t* payload, uint8_t len, uint8_t seq = 0);
+
+  // Same frame in V2 framing (COBS, CRC16, 0x00 delimiter)
+  void appendEspNowTxV2(Bytes& out, const uint8_t mac[6], const uint8_t* payload, uint8_t len, uint8_t seq = 0);
+
+  // `frames` ESPNOW_TX frames, each carrying `len` bytes of pseudo random payload
+  Bytes synthetic(uint8_t len, size_t frames, uint32_t seed = 1, uint8_t version = 1);
+
+  // Typical host traffic: discovery requests, entity commands and WizMote
+  // broadcasts in the proportions the host sends them, repeated `rounds` times
+  Bytes typical(size_t rounds);
+
+  // Raw serial capture (host -> gateway direction) read from disk
+  bool load(const char* path, Bytes& out);
+}
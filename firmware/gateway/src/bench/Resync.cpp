@@ -0,0 +1,311 @@
+#include "Resync.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "espnow/RxFilter.h"
+
+namespace {
+  constexpr uint8_t MAC[6] = {0x8c, 0xaa, 0xb5, 0x52, 0xcf, 0x10};
+
+  // Marks the frames fuzz() appends after every input
+  constexpr uint32_t SENTINEL_V1 = 0xFFFFFF01;
+  constexpr uint32_t SENTINEL_V2 = 0xFFFFFF02;
+
+  // Bytes that mean something to the decoder: delimiter, sync, versions,
+  // types, RX_FILTER rule count limits and payload length limits
+  constexpr uint8_t INTERESTING[] = {0x00, 0x01, 0x02, 0x08, 0x09, 0x10, 0x11, 0x12, 0x21, 0x25,
+                                     0x7F, 0x80, 0xAA, 0xFA, 0xFB, 0xFF};
+
+  uint64_t nowUs = 0;
+
+  uint64_t virtualMicros() {
+    return nowUs;
+  }
+
+  uint32_t next(uint32_t& seed) {
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 16;
+  }
+
+  uint32_t below(uint32_t& seed, uint32_t n) {
+    return next(seed) % n;
+  }
+
+  uint32_t indexOf(const uint8_t* payload, uint8_t len) {
+    if (len < 4) return UINT32_MAX - 1;
+    return payload[0] | payload[1] << 8 | payload[2] << 16 | (uint32_t)payload[3] << 24;
+  }
+
+  /* What the handlers saw, reset for every stream or input */
+
+  std::vector<uint64_t>* handledAt = nullptr; // run(): by frame index, UINT64_MAX until handled
+  uint32_t handled = 0;
+  bool sentinelV1 = false;
+  bool sentinelV2 = false;
+  const char* violation = nullptr;
+
+  void onTx(const uint8_t*, uint8_t, const uint8_t* payload, uint8_t len) {
+    ++handled;
+    if (len > 250) violation = "ESPNOW_TX payload over 250 bytes";
+
+    uint32_t index = indexOf(payload, len);
+    if (index == SENTINEL_V1) sentinelV1 = true;
+    if (index == SENTINEL_V2) sentinelV2 = true;
+    if (handledAt && index < handledAt->size() && (*handledAt)[index] == UINT64_MAX) (*handledAt)[index] = nowUs;
+  }
+
+  void onConfig(uint8_t, const uint8_t*, uint8_t) {
+    ++handled;
+  }
+
+  void onBaud(uint32_t) {
+    ++handled;
+  }
+
+  void onFilter(const uint8_t* table, uint8_t len) {
+    ++handled;
+    if (len < 3 || len != 3 + table[2] * 17) violation = "RX_FILTER length does not match its rule count";
+    else if (table[2] > RxFilter::MAX_RULES) violation = "RX_FILTER over RxFilter::MAX_RULES";
+  }
+
+  void attach(PacketDecoder& decoder, PacketDecoder::Mode mode) {
+    decoder.setMode(mode);
+    decoder.onEspNowTx(onTx);
+    decoder.onEspNowTxMailbox(onTx);
+    decoder.onGatewayConfig(onConfig);
+    decoder.onSerialBaud(onBaud);
+    decoder.onRxFilter(onFilter);
+
+    handled = 0;
+    sentinelV1 = sentinelV2 = false;
+    violation = nullptr;
+  }
+
+  void feed(PacketDecoder& decoder, const uint8_t* data, size_t len) {
+    Serial.inject(data, len);
+    while (decoder.parse()) {}
+  }
+
+  /* fuzz() corpus: frames of each type the host sends, now and then with a
+     length or count past its limit but framing and CRC right */
+
+  FrameStreams::Bytes corpusFrame(uint32_t& seed) {
+    uint8_t tdata[6 + 1 + 1 + 255];
+    bool oversized = !below(seed, 8);
+    size_t len = 0;
+    uint8_t type;
+
+    switch (below(seed, 5)) {
+      case 0:
+      case 1: {
+        type = below(seed, 2) ? PacketDecoder::TYPE_ESPNOW_TX : PacketDecoder::TYPE_ESPNOW_TX_MAILBOX;
+        uint8_t n = oversized ? 251 + below(seed, 5) : below(seed, 4) ? below(seed, 40) : below(seed, 251);
+        memcpy(tdata, MAC, 6);
+        tdata[6] = next(seed);
+        tdata[7] = n;
+        for (uint8_t i = 0; i < n; ++i) tdata[8 + i] = below(seed, 4) ? next(seed) : PacketDecoder::SYNC;
+        len = 8 + n;
+        break;
+      }
+
+      case 2: {
+        type = PacketDecoder::TYPE_GATEWAY_CONFIG;
+        uint8_t n = below(seed, 9);
+        tdata[0] = 1 + below(seed, PacketDecoder::CONFIG_FILTER_HITS);
+        tdata[1] = n;
+        for (uint8_t i = 0; i < n; ++i) tdata[2 + i] = next(seed);
+        len = 2 + n;
+        break;
+      }
+
+      case 3: {
+        type = PacketDecoder::TYPE_SERIAL_BAUD;
+        uint32_t baud = below(seed, 2) ? 115200 : 921600;
+        for (uint8_t i = 0; i < 4; ++i) tdata[i] = baud >> (8 * i);
+        len = 4;
+        break;
+      }
+
+      default: {
+        type = PacketDecoder::TYPE_RX_FILTER;
+        uint8_t rules = oversized ? RxFilter::MAX_RULES + 1 : below(seed, 3);
+        tdata[0] = below(seed, 2);
+        tdata[1] = (uint8_t)-80;
+        tdata[2] = rules;
+        len = 3;
+        for (uint8_t r = 0; r < rules; ++r)
+          for (uint8_t i = 0; i < 17; ++i) tdata[len++] = next(seed);
+        break;
+      }
+    }
+
+    FrameStreams::Bytes out;
+    uint8_t version = below(seed, 2) ? PacketDecoder::VERSION_2 : PacketDecoder::VERSION;
+    FrameStreams::appendFrame(out, type, tdata, len, version);
+    return out;
+  }
+
+  void mutate(FrameStreams::Bytes& input, uint32_t& seed) {
+    // Half of the time in the first header, where lengths and counts are
+    size_t at = input.empty() ? 0 : below(seed, below(seed, 2) ? min<size_t>(input.size(), 12) : input.size());
+
+    switch (below(seed, 6)) {
+      case 0: // bit flip
+        if (!input.empty()) input[at] ^= 1 << below(seed, 8);
+        break;
+      case 1: // interesting byte
+        if (!input.empty()) input[at] = INTERESTING[below(seed, sizeof(INTERESTING))];
+        break;
+      case 2: // insert
+        input.insert(input.begin() + at, below(seed, 2) ? next(seed) : INTERESTING[below(seed, sizeof(INTERESTING))]);
+        break;
+      case 3: // delete
+        if (!input.empty()) input.erase(input.begin() + at);
+        break;
+      case 4: { // duplicate a run
+        size_t n = min<size_t>(1 + below(seed, 16), input.size() - at);
+        FrameStreams::Bytes run(input.begin() + at, input.begin() + at + n);
+        input.insert(input.begin() + below(seed, input.size() + 1), run.begin(), run.end());
+        break;
+      }
+      default: // truncate
+        input.resize(at);
+        break;
+    }
+  }
+
+  void dump(const char* reason, const FrameStreams::Bytes& input) {
+    fprintf(stderr, "fuzz: %s, input (%zu bytes):", reason, input.size());
+    for (size_t i = 0; i < input.size(); ++i) fprintf(stderr, "%s%02x", i % 32 ? " " : "\n  ", input[i]);
+    fprintf(stderr, "\n");
+  }
+}
+
+namespace Resync {
+  Result run(const Corruption::Stream& stream, const Options& options) {
+    PacketDecoder decoder;
+    attach(decoder, options.mode);
+
+    std::vector<uint64_t> at(stream.frames.size(), UINT64_MAX);
+    std::vector<uint64_t> eventAt(stream.events.size());
+    handledAt = &at;
+
+    Serial.clear();
+    setMicrosSource(virtualMicros);
+    nowUs = 1000000;
+
+    double byteUs = 10e6 / options.baud;
+    double clock = nowUs;
+    size_t event = 0;
+    size_t gapBefore = SIZE_MAX; // first valid frame after the last fault
+
+    Result r;
+    bool reading = false;
+    uint64_t readingSince = 0;
+
+    for (size_t i = 0; i < stream.bytes.size(); ++i) {
+      if (event < stream.events.size() && i == stream.events[event].at) {
+        eventAt[event] = nowUs;
+        uint32_t frame = stream.events[event].nextFrame;
+        gapBefore = frame < stream.frames.size() ? stream.frames[frame].at : SIZE_MAX;
+        ++event;
+      }
+      if (i == gapBefore) clock += options.gapMs * 1000.0;
+
+      clock += byteUs;
+      nowUs = clock;
+      feed(decoder, &stream.bytes[i], 1);
+
+      bool now = decoder.readingTdata();
+      if (now && !reading) readingSince = nowUs;
+      if (reading) r.maxStuckUs = max<uint32_t>(r.maxStuckUs, nowUs - readingSince);
+      reading = now;
+    }
+
+    for (size_t e = 0; e < stream.events.size(); ++e) {
+      const Corruption::Event& ev = stream.events[e];
+      uint32_t last = e + 1 < stream.events.size() ? stream.events[e + 1].nextFrame : stream.frames.size();
+
+      size_t lost = 0;
+      uint32_t first = UINT32_MAX;
+      for (uint32_t f = ev.nextFrame; f < last; ++f) {
+        if (at[f] == UINT64_MAX) ++lost;
+        else if (first == UINT32_MAX) first = f;
+      }
+
+      size_t bytes;
+      if (first != UINT32_MAX) {
+        bytes = stream.frames[first].at - ev.at;
+        r.maxResyncUs = max<uint32_t>(r.maxResyncUs, at[first] - eventAt[e]);
+      } else {
+        bytes = (e + 1 < stream.events.size() ? stream.events[e + 1].at : stream.bytes.size()) - ev.at;
+        ++r.unrecovered;
+      }
+
+      ++r.events;
+      r.lost += lost;
+      r.maxLost = max(r.maxLost, lost);
+      r.resyncBytes += bytes;
+      r.maxResyncBytes = max(r.maxResyncBytes, bytes);
+    }
+
+    handledAt = nullptr;
+    setMicrosSource(nullptr);
+    Serial.clear();
+    return r;
+  }
+
+  FuzzResult fuzz(size_t iterations, uint32_t seed, PacketDecoder::Mode mode) {
+    FuzzResult r;
+    setMicrosSource(virtualMicros);
+    nowUs = 1000000;
+
+    FrameStreams::Bytes sentinel1, sentinel2;
+    uint8_t index[4];
+    for (uint8_t i = 0; i < 4; ++i) index[i] = SENTINEL_V1 >> (8 * i);
+    FrameStreams::appendEspNowTx(sentinel1, MAC, index, 4);
+    for (uint8_t i = 0; i < 4; ++i) index[i] = SENTINEL_V2 >> (8 * i);
+    sentinel2.push_back(0x00);
+    FrameStreams::appendEspNowTxV2(sentinel2, MAC, index, 4);
+
+    for (size_t it = 0; it < iterations; ++it) {
+      FrameStreams::Bytes input;
+      for (uint32_t n = 1 + below(seed, 3); n; --n) {
+        FrameStreams::Bytes frame = corpusFrame(seed);
+        input.insert(input.end(), frame.begin(), frame.end());
+      }
+      for (uint32_t n = 1 + below(seed, 6); n; --n) mutate(input, seed);
+
+      PacketDecoder decoder;
+      attach(decoder, mode);
+      Serial.clear();
+
+      // Random chunks, now and then apart by more than the byte timeout
+      for (size_t i = 0; i < input.size();) {
+        size_t n = min<size_t>(1 + below(seed, 64), input.size() - i);
+        nowUs += below(seed, 8) ? 100 * n : below(seed, 2 * PacketDecoder::BYTE_TIMEOUT_MS * 1000);
+        feed(decoder, &input[i], n);
+        i += n;
+      }
+
+      nowUs += (PacketDecoder::BYTE_TIMEOUT_MS + 1) * 1000;
+      feed(decoder, sentinel1.data(), sentinel1.size());
+      nowUs += 1000;
+      feed(decoder, sentinel2.data(), sentinel2.size());
+
+      const char* failure = violation;
+      if (!failure && !sentinelV1) failure = "V1 frame after an idle gap not handled";
+      if (!failure && !sentinelV2) failure = "delimited V2 frame not handled";
+      if (!failure && decoder.counters().frames != handled) failure = "counters().frames differs from frames handled";
+
+      ++r.iterations;
+      if (failure && !r.failures++) dump(failure, input);
+    }
+
+    setMicrosSource(nullptr);
+    Serial.clear();
+    return r;
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "Corruption.h"
+#include "serial/PacketDecoder.h"
+
+// How PacketDecoder recovers from line faults. Streams are fed one byte at a
+// time on a virtual clock running at the UART rate, so BYTE_TIMEOUT_MS acts
+// as it does on the gateway.
+namespace Resync {
+  struct Options {
+    PacketDecoder::Mode mode = PacketDecoder::MODE_BLOCK;
+    uint32_t baud = 115200;
+    uint32_t gapMs = 0; // line idle after each fault, 0 for back to back frames
+  };
+
+  struct Result {
+    size_t events = 0;
+    size_t lost = 0;           // valid frames never handled
+    size_t maxLost = 0;        // by a single fault
+    size_t resyncBytes = 0;    // from a fault up to the first valid frame handled after it
+    size_t maxResyncBytes = 0;
+    uint32_t maxResyncUs = 0;  // from a fault until that frame was handled
+    uint32_t maxStuckUs = 0;   // longest stretch in READ_TDATA
+    size_t unrecovered = 0;    // faults with no frame handled before the next one
+  };
+
+  Result run(const Corruption::Stream& stream, const Options& options);
+
+  struct FuzzResult {
+    size_t iterations = 0;
+    size_t failures = 0;
+  };
+
+  // Mutated frames of every type, a few with lengths past their limits, fed
+  // in random chunks. Each input is followed by a V1 frame after an idle gap
+  // over BYTE_TIMEOUT_MS and by a delimited V2 frame: both must be handled,
+  // handlers must only see lengths their frame allows and counters().frames
+  // must match what they saw. The first failing input is dumped to stderr.
+  FuzzResult fuzz(size_t iterations, uint32_t seed, PacketDecoder::Mode mode);
+}
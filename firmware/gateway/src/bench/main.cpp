@@ -0,0 +1,310 @@
+// Serial codec microbenchmarks, built by the `native` env:
+//
+//   pio run -e native && .pio/build/native/program [--step N] [--frames N] [--csv] [--replay FILE]
+//   pio run -e native && .pio/build/native/program --resync [--frames N] [--csv]
+//   pio run -e native && .pio/build/native/program --fuzz N
+//   pio run -e native && .pio/build/native/program --gate
+//
+// Every row reports frames/s, bytes/s (serial bytes, envelope included) and
+// cycles per frame for one operation at one payload size.
+//
+// --resync instead reports how the decoder gets back in step after each kind
+// of line fault (see Corruption.h), with frames sent back to back and with
+// the line idle for IDLE_GAP_MS after the fault. --fuzz runs the mutation
+// fuzzer in Resync.h. --gate runs both and exits non zero when any row is
+// past its limit, run it after every decoder change.
+
+#include <Arduino.h>
+
+#include <chrono>
+#include <stdio.h>
+
+#include "serial/PacketDecoder.h"
+#include "serial/PacketEncoder.h"
+#include "espnow/RxBatch.h"
+#include "FrameStreams.h"
+#include "Corruption.h"
+#include "Resync.h"
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  constexpr uint8_t MAC[6] = {0x8c, 0xaa, 0xb5, 0x52, 0xcf, 0x10};
+
+  struct Options {
+    unsigned step = 1;
+    size_t frames = 2000;
+    bool csv = false;
+    const char* replay = nullptr;
+    bool resync = false;
+    size_t fuzz = 0;
+    bool gate = false;
+  } opts;
+
+  struct Result {
+    size_t frames = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    uint64_t cycles = 0;
+  };
+
+  size_t decodedFrames = 0;
+
+  void countFrame(const uint8_t*, uint8_t, const uint8_t*, uint8_t) {
+    ++decodedFrames;
+  }
+
+  constexpr PacketDecoder::Mode DECODER_MODES[] = {PacketDecoder::MODE_BYTE, PacketDecoder::MODE_BLOCK};
+
+  // Decoder rows are reported once per mode, MODE_BLOCK ones get a ".block" suffix
+  const char* label(const char* op, PacketDecoder::Mode mode) {
+    static char buf[64];
+    snprintf(buf, sizeof(buf), "%s%s", op, mode == PacketDecoder::MODE_BLOCK ? ".block" : "");
+    return buf;
+  }
+
+  void report(const char* op, int size, const Result& r) {
+    double fps = r.seconds > 0 ? r.frames / r.seconds : 0;
+    double bps = r.seconds > 0 ? r.bytes / r.seconds : 0;
+    double cpf = r.frames ? double(r.cycles) / r.frames : 0;
+
+    if (opts.csv) {
+      printf("%s,%d,%zu,%.0f,%.0f,%.1f\n", op, size, r.frames, fps, bps, cpf);
+    } else if (size < 0) {
+      printf("%-22s %5s %8zu %14.0f %14.0f %12.1f\n", op, "-", r.frames, fps, bps, cpf);
+    } else {
+      printf("%-22s %5d %8zu %14.0f %14.0f %12.1f\n", op, size, r.frames, fps, bps, cpf);
+    }
+  }
+
+  Result decode(const FrameStreams::Bytes& stream, PacketDecoder::Mode mode) {
+    PacketDecoder decoder;
+    decoder.setMode(mode);
+    decoder.onEspNowTx(countFrame);
+
+    Serial.clear();
+    Serial.inject(stream.data(), stream.size());
+    decodedFrames = 0;
+
+    Result r;
+    auto t0 = Clock::now();
+    // MODE_BLOCK keeps bytes past a frame in its ring, drain that too
+    bool handled;
+    do {
+      uint32_t c0 = ESP.getCycleCount();
+      handled = decoder.parse();
+      r.cycles += uint32_t(ESP.getCycleCount() - c0);
+    } while (handled || Serial.available());
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.frames = decodedFrames;
+    r.bytes = stream.size();
+    return r;
+  }
+
+  template<typename F>
+  Result encode(size_t frames, F&& send) {
+    Serial.clear();
+
+    Result r;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < frames; ++i) {
+      uint32_t c0 = ESP.getCycleCount();
+      send();
+      r.cycles += uint32_t(ESP.getCycleCount() - c0);
+    }
+    r.seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+    r.frames = frames;
+    r.bytes = Serial.txCount();
+    return r;
+  }
+
+  // Line idle after a fault in the ".idle" resync rows, a pause between host
+  // bursts. BYTE_TIMEOUT_MS has to stay below it for V1 to lose nothing
+  constexpr uint32_t IDLE_GAP_MS = 20;
+  constexpr uint32_t RESYNC_BAUD = 115200;
+  constexpr size_t GATE_FUZZ_ITERATIONS = 20000;
+
+  // Past any of these a --gate run fails
+  struct Limits {
+    size_t maxLost;
+    size_t maxBytes;
+    uint32_t maxStuckMs;
+  };
+
+  Limits limits(uint8_t version, bool idle) {
+    // A V1 header can claim up to 258 bytes of TDATA, 22.4 ms at 115200.
+    // Back to back, those bytes are lost whatever frames they held, so only
+    // the bytes are bounded: the fault, the claim and the frame it ends in.
+    // With the line idle after the fault BYTE_TIMEOUT_MS clears the claim
+    // and only the fault is skipped, a 75 byte frame at most
+    if (version == PacketDecoder::VERSION) {
+      return idle ? Limits{0, 80, 23 + IDLE_GAP_MS} : Limits{SIZE_MAX, 400, 23};
+    }
+    // The host sends no leading delimiter, a fault runs into its next V2
+    // frame and no further: the fault plus one frame. The V1 parser still
+    // reads V2 bytes, hence the same stuck limit
+    return Limits{1, 160, 23 + IDLE_GAP_MS};
+  }
+
+  void reportResync(const char* op, const Resync::Result& r) {
+    double lost = r.events ? double(r.lost) / r.events : 0;
+    double bytes = r.events ? double(r.resyncBytes) / r.events : 0;
+
+    if (opts.csv) {
+      printf("%s,%zu,%.3f,%zu,%.1f,%zu,%.2f,%.2f,%zu\n", op, r.events, lost, r.maxLost, bytes, r.maxResyncBytes,
+             r.maxResyncUs / 1000.0, r.maxStuckUs / 1000.0, r.unrecovered);
+    } else {
+      printf("%-34s %6zu %8.3f %8zu %8.1f %9zu %9.2f %9.2f %6zu\n", op, r.events, lost, r.maxLost, bytes,
+             r.maxResyncBytes, r.maxResyncUs / 1000.0, r.maxStuckUs / 1000.0, r.unrecovered);
+    }
+  }
+
+  int resyncMain() {
+    size_t failures = 0;
+
+    if (opts.resync || opts.gate) {
+      if (opts.csv) {
+        printf("op,events,lost_per_event,max_lost,bytes_per_event,max_bytes,max_resync_ms,max_stuck_ms,unrecovered\n");
+      } else {
+        printf("%-34s %6s %8s %8s %8s %9s %9s %9s %6s\n", "op", "events", "lost/ev", "max lost", "bytes/ev",
+               "max bytes", "resync ms", "stuck ms", "unrec");
+      }
+
+      size_t events = opts.frames / 4 + 1;
+      for (PacketDecoder::Mode mode : DECODER_MODES) {
+        for (uint8_t version : {PacketDecoder::VERSION, PacketDecoder::VERSION_2}) {
+          for (bool idle : {false, true}) {
+            for (uint8_t k = 0; k < Corruption::KIND_COUNT; ++k) {
+              Corruption::Kind kind = (Corruption::Kind)k;
+              Resync::Options o;
+              o.mode = mode;
+              o.baud = RESYNC_BAUD;
+              o.gapMs = idle ? IDLE_GAP_MS : 0;
+              Resync::Result r = Resync::run(Corruption::build(kind, events, version, k + 1), o);
+
+              char op[48];
+              snprintf(op, sizeof(op), "resync.v%u.%s%s", version, Corruption::name(kind), idle ? ".idle" : "");
+              reportResync(label(op, mode), r);
+
+              Limits l = limits(version, idle);
+              if (opts.gate && (r.maxLost > l.maxLost || r.maxResyncBytes > l.maxBytes || r.maxStuckUs > l.maxStuckMs * 1000)) {
+                fprintf(stderr, "gate: %s over its limits (lost %zu, bytes %zu, stuck %u ms)\n",
+                        label(op, mode), l.maxLost, l.maxBytes, l.maxStuckMs);
+                ++failures;
+              }
+            }
+          }
+        }
+      }
+    }
+
+    size_t iterations = opts.fuzz ? opts.fuzz : opts.gate ? GATE_FUZZ_ITERATIONS : 0;
+    if (iterations) {
+      for (PacketDecoder::Mode mode : DECODER_MODES) {
+        Resync::FuzzResult r = Resync::fuzz(iterations, 1, mode);
+        printf("%s: %zu inputs, %zu failed\n", label("fuzz", mode), r.iterations, r.failures);
+        failures += r.failures;
+      }
+    }
+
+    return failures ? 1 : 0;
+  }
+
+  void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+      if (!strcmp(argv[i], "--step") && i + 1 < argc)        opts.step = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--frames") && i + 1 < argc) opts.frames = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--replay") && i + 1 < argc) opts.replay = argv[++i];
+      else if (!strcmp(argv[i], "--fuzz") && i + 1 < argc)   opts.fuzz = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--resync"))                 opts.resync = true;
+      else if (!strcmp(argv[i], "--gate"))                   opts.gate = true;
+      else if (!strcmp(argv[i], "--csv"))                    opts.csv = true;
+    }
+    if (!opts.step) opts.step = 1;
+    if (!opts.frames) opts.frames = 1;
+  }
+}
+
+int main(int argc, char** argv) {
+  parseArgs(argc, argv);
+
+  if (opts.resync || opts.fuzz || opts.gate) return resyncMain();
+
+  if (opts.csv) printf("op,size,frames,frames_per_s,bytes_per_s,cycles_per_frame\n");
+  else printf("%-22s %5s %8s %14s %14s %12s\n", "op", "size", "frames", "frames/s", "bytes/s", "cycles/frame");
+
+  uint8_t payload[256];
+  for (size_t i = 0; i < sizeof(payload); ++i) payload[i] = i * 37;
+
+  for (PacketDecoder::Mode mode : DECODER_MODES) {
+    for (unsigned size = 0; size <= 250; size += opts.step) {
+      report(label("decode.espnow_tx", mode), size, decode(FrameStreams::synthetic(size, opts.frames), mode));
+    }
+  }
+
+  for (PacketDecoder::Mode mode : DECODER_MODES) {
+    for (unsigned size = 0; size <= 250; size += opts.step) {
+      auto stream = FrameStreams::synthetic(size, opts.frames, 1, PacketDecoder::VERSION_2);
+      report(label("decode.v2_tx", mode), size, decode(stream, mode));
+    }
+  }
+
+  for (unsigned size = 0; size <= 250; size += opts.step) {
+    report("encode.espnow_rx", size, encode(opts.frames, [&] {
+      PacketEncoder::sendEspNowPacket(MAC, -42, payload, size);
+    }));
+  }
+
+  PacketEncoder::setVersion(PacketEncoder::VERSION_2);
+  for (unsigned size = 0; size <= 250; size += opts.step) {
+    report("encode.v2_rx", size, encode(opts.frames, [&] {
+      PacketEncoder::sendEspNowPacket(MAC, -42, payload, size);
+    }));
+  }
+  PacketEncoder::setVersion(PacketEncoder::VERSION);
+
+  // One row per record: a full batch is flushed every time the next record does not fit
+  for (unsigned size = 0; size <= 250; size += opts.step) {
+    RxBatch batch;
+    batch.configure(RxBatch::CAPACITY, 0xffff);
+
+    RxFrame frame = {};
+    memcpy(frame.mac, MAC, 6);
+    frame.rssi = -42;
+    frame.len = size;
+    memcpy(frame.data, payload, size);
+
+    report("encode.rx_batch", size, encode(opts.frames, [&] {
+      if (!batch.add(frame, 0)) {
+        batch.flush();
+        batch.add(frame, 0);
+      }
+    }));
+  }
+
+  report("encode.tx_status", -1, encode(opts.frames, [] {
+    PacketEncoder::sendEspNowTxStatusPacket(MAC, 0, 0);
+  }));
+
+  report("encode.gw_init", -1, encode(opts.frames, [] {
+    PacketEncoder::sendGatewayInitPacket(MAC);
+  }));
+
+  for (PacketDecoder::Mode mode : DECODER_MODES) {
+    report(label("decode.typical", mode), -1, decode(FrameStreams::typical(opts.frames / 5 + 1), mode));
+  }
+
+  if (opts.replay) {
+    FrameStreams::Bytes capture;
+    if (FrameStreams::load(opts.replay, capture)) {
+      for (PacketDecoder::Mode mode : DECODER_MODES) {
+        report(label("decode.replay", mode), -1, decode(capture, mode));
+      }
+    } else {
+      fprintf(stderr, "cannot read %s\n", opts.replay);
+      return 1;
+    }
+  }
+
+  return 0;
+}
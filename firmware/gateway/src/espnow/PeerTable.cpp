@@ -0,0 +1,79 @@
+#include "PeerTable.h"
+
+#include "serial/PacketEncoder.h"
+
+// Weight of a new RSSI sample, 1 / 2^RSSI_SHIFT
+static constexpr uint8_t RSSI_SHIFT = 3;
+
+void PeerTable::configure(uint16_t dedupWindowMs) {
+  _dedupWindowMs = dedupWindowMs;
+}
+
+bool PeerTable::seen(const uint8_t* mac, int8_t rssi, const uint8_t* data, uint8_t len, unsigned long now) {
+  Peer& p = slotFor(mac);
+  uint32_t print = fingerprint(data, len);
+  bool known = p.frames != 0;
+
+  bool duplicate = known && _dedupWindowMs && print == p.fingerprint && now - p.fingerprintAt < _dedupWindowMs;
+
+  int16_t sample = rssi * 16;
+  p.rssiAvg = known ? p.rssiAvg + ((sample - p.rssiAvg) >> RSSI_SHIFT) : sample;
+  p.lastSeenAt = now;
+  ++p.frames;
+
+  if (duplicate) {
+    ++p.duplicates;
+    ++_duplicates;
+    return false;
+  }
+
+  p.fingerprint = print;
+  p.fingerprintAt = now;
+  return true;
+}
+
+// <MAC(6)><AGE_MS(4)><RSSI(1)><FRAMES(4)><DUPLICATES(4)> per peer
+void PeerTable::send(unsigned long now) const {
+  uint8_t records[MAX_PEERS * RECORD_SIZE];
+  uint8_t count = 0;
+  size_t idx = 0;
+
+  auto writeU32 = [&](uint32_t value) {
+    for (uint8_t i = 0; i < 4; ++i) records[idx++] = value >> (8 * i);
+  };
+
+  for (const Peer& p : _peers) {
+    if (!p.used) continue;
+
+    memcpy(&records[idx], p.mac, 6);
+    idx += 6;
+    writeU32(now - p.lastSeenAt);
+    records[idx++] = (int8_t)((p.rssiAvg + 8) >> 4);
+    writeU32(p.frames);
+    writeU32(p.duplicates);
+    ++count;
+  }
+
+  PacketEncoder::sendGatewayPeersPacket(count, records, idx);
+}
+
+// The peer's entry, else a new one in place of the least recently heard
+PeerTable::Peer& PeerTable::slotFor(const uint8_t* mac) {
+  Peer* oldest = nullptr;
+  for (Peer& p : _peers) {
+    if (p.used && !memcmp(p.mac, mac, 6)) return p;
+    if (!oldest || (oldest->used && (!p.used || (long)(oldest->lastSeenAt - p.lastSeenAt) > 0))) oldest = &p;
+  }
+
+  *oldest = {};
+  oldest->used = true;
+  memcpy(oldest->mac, mac, 6);
+  return *oldest;
+}
+
+// FNV-1a, a false match takes a 32 bit collision inside the window
+uint32_t PeerTable::fingerprint(const uint8_t* data, uint8_t len) {
+  uint32_t h = 2166136261u;
+  for (uint8_t i = 0; i < len; ++i) h = (h ^ data[i]) * 16777619u;
+  return h;
+}
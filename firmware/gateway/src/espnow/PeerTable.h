@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+
+// What the gateway knows about each sender, keyed by MAC: when it was last
+// heard, a moving average of its RSSI and a fingerprint of the last payload
+// forwarded. Repeats of that payload inside the dedup window (retransmits
+// whose ack got lost, broadcasts sent more than once) are dropped before they
+// reach the host. The window runs from the forwarded frame, repeats do not
+// extend it. Dumped as GATEWAY_PEERS on request. Used from loop() only.
+class PeerTable {
+public:
+  static constexpr uint8_t MAX_PEERS = 16;
+  static constexpr size_t RECORD_SIZE = 6 + 4 + 1 + 4 + 4; // MAC + AGE_MS + RSSI + FRAMES + DUPLICATES
+
+  // 0 disables duplicate suppression, which is the default after boot
+  void configure(uint16_t dedupWindowMs);
+
+  // Records a received frame, false when it is a duplicate to drop
+  bool seen(const uint8_t* mac, int8_t rssi, const uint8_t* data, uint8_t len, unsigned long now);
+
+  // Duplicates dropped since boot
+  uint32_t duplicates() const { return _duplicates; }
+
+  void send(unsigned long now) const;
+
+private:
+  struct Peer {
+    bool used;
+    uint8_t mac[6];
+    unsigned long lastSeenAt;
+    int16_t rssiAvg; // dBm x 16
+    uint32_t frames;
+    uint32_t duplicates;
+    uint32_t fingerprint; // of the last payload forwarded
+    unsigned long fingerprintAt;
+  };
+
+  Peer _peers[MAX_PEERS] = {};
+
+  uint16_t _dedupWindowMs = 0;
+  uint32_t _duplicates = 0;
+
+  Peer& slotFor(const uint8_t* mac);
+  static uint32_t fingerprint(const uint8_t* data, uint8_t len);
+};
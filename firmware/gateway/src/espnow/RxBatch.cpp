@@ -0,0 +1,43 @@
+#include "RxBatch.h"
+
+#include "serial/PacketEncoder.h"
+
+void RxBatch::configure(uint16_t maxBytes, uint16_t maxAgeMs) {
+  flush();
+  _maxBytes = maxBytes > CAPACITY ? CAPACITY : maxBytes;
+  _maxAgeMs = maxAgeMs;
+}
+
+bool RxBatch::fits(const RxFrame& f) const {
+  return _count < 255 && _len + RECORD_HEADER + f.len <= _maxBytes;
+}
+
+bool RxBatch::add(const RxFrame& f, unsigned long now) {
+  if (!fits(f)) return false;
+
+  if (_count == 0) _firstAt = now;
+
+  uint8_t* p = _buf + _len;
+  memcpy(p, f.mac, 6);
+  p[6] = static_cast<uint8_t>(f.rssi);
+  p[7] = f.len;
+  memcpy(p + RECORD_HEADER, f.data, f.len);
+
+  _len += RECORD_HEADER + f.len;
+  ++_count;
+  return true;
+}
+
+bool RxBatch::due(unsigned long now) const {
+  if (_count == 0) return false;
+  if (_len + RECORD_HEADER > _maxBytes) return true;
+  return now - _firstAt >= _maxAgeMs;
+}
+
+void RxBatch::flush() {
+  if (_count == 0) return;
+
+  PacketEncoder::sendEspNowBatchPacket(_count, _buf, _len);
+  _count = 0;
+  _len = 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "RxQueue.h"
+
+// Accumulates received frames as ESPNOW_RX_BATCH records until the batch is
+// full or its oldest record is too old. Disabled (max bytes 0) by default so
+// hosts that do not know the batch packet keep getting plain ESPNOW_RX.
+class RxBatch {
+public:
+  static constexpr size_t CAPACITY = 512;
+  static constexpr size_t RECORD_HEADER = 6 + 1 + 1; // MAC + RSSI + LEN
+
+  void configure(uint16_t maxBytes, uint16_t maxAgeMs);
+  bool enabled() const { return _maxBytes != 0; }
+
+  // False when the record does not fit, flush() first
+  bool add(const RxFrame& f, unsigned long now);
+  bool fits(const RxFrame& f) const;
+
+  // Full or oldest record older than the age limit
+  bool due(unsigned long now) const;
+
+  void flush();
+
+private:
+  uint8_t  _buf[CAPACITY];
+  uint16_t _len = 0;
+  uint8_t  _count = 0;
+  unsigned long _firstAt = 0;
+
+  uint16_t _maxBytes = 0;
+  uint16_t _maxAgeMs = 0;
+};
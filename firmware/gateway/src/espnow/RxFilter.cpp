@@ -0,0 +1,71 @@
+#include "RxFilter.h"
+
+#include "serial/PacketEncoder.h"
+
+bool RxFilter::configure(const uint8_t* table, uint8_t len) {
+  if (len < HEADER_SIZE) return false;
+
+  uint8_t count = table[2];
+  if (table[0] > DENY || count > MAX_RULES || len != HEADER_SIZE + count * RULE_SIZE) return false;
+
+  for (uint8_t i = 0; i < count; ++i) {
+    const uint8_t* r = table + HEADER_SIZE + i * RULE_SIZE;
+    if (r[0] > DENY || r[8] > MAX_PREFIX) return false;
+  }
+
+  _default = (Action)table[0];
+  _minRssi = (int8_t)table[1];
+  _count = count;
+  for (uint8_t i = 0; i < count; ++i) {
+    const uint8_t* r = table + HEADER_SIZE + i * RULE_SIZE;
+    Rule& rule = _rules[i];
+    rule.action = (Action)r[0];
+    rule.flags = r[1];
+    memcpy(rule.mac, r + 2, 6);
+    rule.prefixLen = r[8];
+    memcpy(rule.prefix, r + 9, MAX_PREFIX);
+    rule.hits = 0;
+  }
+
+  _rssiHits = 0;
+  _defaultHits = 0;
+  return true;
+}
+
+bool RxFilter::accepts(const RxFrame& f) {
+  Action action = _default;
+
+  if (f.rssi < _minRssi) {
+    ++_rssiHits;
+    action = DENY;
+  } else {
+    Rule* rule = nullptr;
+    for (uint8_t i = 0; i < _count && !rule; ++i) {
+      if (matches(_rules[i], f)) rule = &_rules[i];
+    }
+
+    if (rule) {
+      ++rule->hits;
+      action = rule->action;
+    } else {
+      ++_defaultHits;
+    }
+  }
+
+  if (action == DENY) ++_dropped;
+  return action == ALLOW;
+}
+
+// <RSSI_HITS(4)><DEFAULT_HITS(4)><COUNT(1)><HITS(4)>...
+void RxFilter::send() const {
+  uint32_t hits[MAX_RULES];
+  for (uint8_t i = 0; i < _count; ++i) hits[i] = _rules[i].hits;
+
+  PacketEncoder::sendRxFilterHitsPacket(_rssiHits, _defaultHits, hits, _count);
+}
+
+// A rule without conditions matches every frame
+bool RxFilter::matches(const Rule& r, const RxFrame& f) {
+  if ((r.flags & MATCH_MAC) && memcmp(r.mac, f.mac, 6)) return false;
+  return f.len >= r.prefixLen && !memcmp(r.prefix, f.data, r.prefixLen);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "RxQueue.h"
+
+// Drops received frames the host does not want before they are encoded
+// (RX_FILTER). Frames weaker than the minimum RSSI go first, the rest are
+// decided by the first rule that matches, else by the default action.
+// Empty after boot, which forwards everything. Used from loop() only.
+class RxFilter {
+public:
+  static constexpr uint8_t MAX_RULES = 8;
+  static constexpr uint8_t MAX_PREFIX = 8;
+  static constexpr size_t HEADER_SIZE = 1 + 1 + 1;                // DEFAULT + MIN_RSSI + COUNT
+  static constexpr size_t RULE_SIZE = 1 + 1 + 6 + 1 + MAX_PREFIX; // ACTION + FLAGS + MAC + PREFIX_LEN + PREFIX
+
+  enum Action : uint8_t {
+    ALLOW,
+    DENY
+  };
+
+  /* Rule FLAGS */
+  static constexpr uint8_t MATCH_MAC = 0x01;
+
+  // RX_FILTER TDATA, replaces the table and clears the hit counters. False
+  // when it does not hold a valid table, the old one stays then
+  bool configure(const uint8_t* table, uint8_t len);
+
+  bool accepts(const RxFrame& f);
+
+  // Frames dropped since boot, for GATEWAY_STATS
+  uint32_t dropped() const { return _dropped; }
+
+  // RX_FILTER_HITS with the counters of the current table
+  void send() const;
+
+private:
+  struct Rule {
+    Action action;
+    uint8_t flags;
+    uint8_t mac[6];
+    uint8_t prefixLen;
+    uint8_t prefix[MAX_PREFIX];
+    uint32_t hits;
+  };
+
+  Rule _rules[MAX_RULES];
+  uint8_t _count = 0;
+  Action _default = ALLOW;
+  int8_t _minRssi = INT8_MIN;
+
+  uint32_t _rssiHits = 0;
+  uint32_t _defaultHits = 0;
+  uint32_t _dropped = 0;
+
+  static bool matches(const Rule& r, const RxFrame& f);
+};
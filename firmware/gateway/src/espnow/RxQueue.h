@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+struct RxFrame {
+  static constexpr uint8_t MAX_PAYLOAD = 250;
+
+  uint8_t mac[6];
+  int8_t  rssi;
+  uint8_t len;
+  uint8_t data[MAX_PAYLOAD];
+};
+
+// Single producer (radio receive callback) / single consumer (loop) ring of
+// received frames. Frames are stored inline so the producer never allocates.
+template<uint8_t N>
+class RxQueue {
+  static_assert(N && !(N & (N - 1)), "RxQueue size must be a power of two");
+
+public:
+  // Producer side
+  bool push(const uint8_t* mac, int8_t rssi, const uint8_t* data, uint8_t len) {
+    if (len > RxFrame::MAX_PAYLOAD) return false;
+
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t used = head - _tail.load(std::memory_order_acquire);
+    if (used >= N) {
+      _overflows.store(_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    RxFrame& f = _slots[head & (N - 1)];
+    memcpy(f.mac, mac, 6);
+    f.rssi = rssi;
+    f.len  = len;
+    memcpy(f.data, data, len);
+
+    _head.store(head + 1, std::memory_order_release);
+
+    if (used + 1 > _highWater.load(std::memory_order_relaxed))
+      _highWater.store(used + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Consumer side, the returned frame stays valid until pop()
+  const RxFrame* peek() const {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return nullptr;
+    return &_slots[tail & (N - 1)];
+  }
+
+  void pop() {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  uint8_t capacity() const { return N; }
+  uint8_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  // Frames offered by the producer since boot, dropped ones included
+  uint32_t received() const {
+    return _head.load(std::memory_order_acquire) + _overflows.load(std::memory_order_relaxed);
+  }
+  // Frames dropped because the ring was full
+  uint32_t overflows() const { return _overflows.load(std::memory_order_relaxed); }
+  // Deepest fill level seen since boot
+  uint8_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+  RxFrame _slots[N];
+
+  std::atomic<uint32_t> _head{0};
+  std::atomic<uint32_t> _tail{0};
+
+  std::atomic<uint32_t> _overflows{0};
+  std::atomic<uint8_t>  _highWater{0};
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "TxQueue.h"
+
+// ESPNOW_TX_MAILBOX frames for peers that sleep between short wakes and
+// only listen right after they sent something. Each peer keeps its latest
+// frame only, it is released once the peer is heard and stays held when it
+// could not be delivered in time, until it is `ttl` ms old: then expired()
+// hands it back to be failed, so peers that never wake cannot keep their
+// slots forever. Filled and drained from loop() only.
+//
+// Mail does not use TxQueue slots, so ESPNOW_TX credits are unaffected.
+template<uint8_t N>
+class TxMailbox {
+public:
+  enum Result {
+    HELD,
+    REPLACED, // an older frame for the peer was dropped, its seq in `replaced`
+    FULL
+  };
+
+  Result hold(const uint8_t* mac, uint8_t seq, const uint8_t* data, uint8_t len, unsigned long now, uint8_t& replaced) {
+    if (len > TxFrame::MAX_PAYLOAD) return FULL;
+
+    // The frame on air keeps its slot, a newer one takes another
+    Slot* s = find(mac, false);
+    Result result = s ? REPLACED : HELD;
+    if (s) replaced = s->frame.seq;
+    else s = freeSlot();
+    if (!s) return FULL;
+
+    memcpy(s->frame.mac, mac, 6);
+    s->frame.seq = seq;
+    s->frame.attempts = 0;
+    s->frame.len = len;
+    memcpy(s->frame.data, data, len);
+    s->used = true;
+    s->released = false;
+    s->sending = false;
+    s->heldAt = now;
+    return result;
+  }
+
+  // The peer is awake, its mail may go out
+  void heard(const uint8_t* mac) {
+    if (Slot* s = find(mac, false)) s->released = true;
+  }
+
+  // Released frame `ready(frame)` accepts, marked as on air
+  template<typename Ready>
+  TxFrame* take(Ready ready) {
+    for (Slot& s : _slots) {
+      if (!s.used || !s.released || s.sending || !ready(s.frame)) continue;
+      s.sending = true;
+      ++s.frame.attempts;
+      return &s.frame;
+    }
+    return nullptr;
+  }
+
+  bool owns(const TxFrame* f) const {
+    return f >= &_slots[0].frame && f <= &_slots[N - 1].frame;
+  }
+
+  // Delivered, or replaced while on air
+  void remove(const TxFrame* f) {
+    slotOf(f).used = false;
+  }
+
+  // Not delivered, wait for the next wake. False when a newer frame for the
+  // peer came in meanwhile, this one is dropped then.
+  bool keep(const TxFrame* f) {
+    Slot& s = slotOf(f);
+    if (superseded(s)) return false;
+
+    s.sending = false;
+    s.released = false;
+    s.frame.attempts = 0;
+    return true;
+  }
+
+  // A frame held longer than `ttl` and not on air, to be failed and removed
+  TxFrame* expired(unsigned long now, unsigned long ttl) {
+    for (Slot& s : _slots)
+      if (s.used && !s.sending && now - s.heldAt >= ttl) return &s.frame;
+    return nullptr;
+  }
+
+  // A failed attempt, the frame goes out again once `ready` allows. False
+  // like keep() when a newer frame for the peer came in meanwhile.
+  bool retry(const TxFrame* f) {
+    Slot& s = slotOf(f);
+    if (superseded(s)) return false;
+
+    s.sending = false;
+    return true;
+  }
+
+  uint8_t size() const {
+    uint8_t n = 0;
+    for (const Slot& s : _slots) n += s.used;
+    return n;
+  }
+
+private:
+  struct Slot {
+    TxFrame frame;
+    bool used;
+    bool released;
+    bool sending;
+    unsigned long heldAt; // kept across keep(), a wake does not extend it
+  };
+
+  Slot _slots[N] = {};
+
+  Slot& slotOf(const TxFrame* f) {
+    for (Slot& s : _slots)
+      if (&s.frame == f) return s;
+    return _slots[0];
+  }
+
+  Slot* find(const uint8_t* mac, bool sending) {
+    for (Slot& s : _slots)
+      if (s.used && s.sending == sending && !memcmp(s.frame.mac, mac, 6)) return &s;
+    return nullptr;
+  }
+
+  // Frees the slot on air when hold() put a newer frame for its peer in
+  // another, so a peer never has two frames held
+  bool superseded(Slot& s) {
+    if (!find(s.frame.mac, false)) return false;
+    s.used = false;
+    return true;
+  }
+
+  Slot* freeSlot() {
+    for (Slot& s : _slots)
+      if (!s.used) return &s;
+    return nullptr;
+  }
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+
+struct TxFrame {
+  static constexpr uint8_t MAX_PAYLOAD = 250;
+
+  uint8_t mac[6];
+  uint8_t seq;
+  uint8_t attempts; // radio sends so far
+  uint8_t len;
+  uint8_t data[MAX_PAYLOAD];
+};
+
+// ESPNOW_TX frames accepted from the host and waiting for the radio. The
+// host may only send as many as it has credits (free slots) for, see
+// ESPNOW_TX_CREDITS. Filled and drained from loop() only.
+//
+// Frames leave in arrival order unless the caller skips some (a peer that is
+// backing off), so slots are freed individually rather than as a ring.
+template<uint8_t N>
+class TxQueue {
+  static_assert(N && N <= 32, "TxQueue size must be 1..32");
+
+public:
+  /* ESPNOW_TX_STATUS values, radio ones come straight from onDataSent */
+  static constexpr uint8_t STATUS_OK         = 0x00;
+  static constexpr uint8_t STATUS_FAILED     = 0x01;
+  static constexpr uint8_t STATUS_QUEUE_FULL = 0x02;
+  static constexpr uint8_t STATUS_REPLACED   = 0x03; // mailbox frame superseded, never sent
+
+  bool push(const uint8_t* mac, uint8_t seq, const uint8_t* data, uint8_t len) {
+    if (len > TxFrame::MAX_PAYLOAD || _size >= N) return false;
+
+    uint8_t i = 0;
+    while (_used & (1u << i)) ++i;
+
+    TxFrame& f = _slots[i];
+    memcpy(f.mac, mac, 6);
+    f.seq = seq;
+    f.attempts = 0;
+    f.len = len;
+    memcpy(f.data, data, len);
+
+    _order[i] = _pushed++;
+    _used |= 1u << i;
+    ++_size;
+    return true;
+  }
+
+  // Oldest frame `ready(frame)` accepts, stays valid until remove()
+  template<typename Ready>
+  TxFrame* find(Ready ready) {
+    TxFrame* oldest = nullptr;
+    uint32_t oldestOrder = 0;
+
+    for (uint8_t i = 0; i < N; ++i) {
+      if (!(_used & (1u << i))) continue;
+      if (oldest && (int32_t)(_order[i] - oldestOrder) > 0) continue;
+      if (!ready(_slots[i])) continue;
+
+      oldest = &_slots[i];
+      oldestOrder = _order[i];
+    }
+    return oldest;
+  }
+
+  void remove(const TxFrame* f) {
+    uint8_t i = f - _slots;
+    _used &= ~(1u << i);
+    --_size;
+  }
+
+  uint8_t capacity() const { return N; }
+  uint8_t size() const { return _size; }
+  uint8_t free() const { return N - _size; }
+
+private:
+  TxFrame _slots[N];
+  uint32_t _order[N];
+
+  uint32_t _used = 0;
+  uint32_t _pushed = 0;
+  uint8_t _size = 0;
+};
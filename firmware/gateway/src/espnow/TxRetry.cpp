@@ -0,0 +1,52 @@
+#include "TxRetry.h"
+
+void TxRetry::configure(uint8_t maxAttempts, uint16_t backoffMs, uint16_t maxBackoffMs) {
+  _maxAttempts = maxAttempts ? maxAttempts : 1;
+  _backoffMs = backoffMs;
+  _maxBackoffMs = maxBackoffMs < backoffMs ? backoffMs : maxBackoffMs;
+}
+
+bool TxRetry::ready(const uint8_t* mac, unsigned long now) const {
+  int8_t i = indexOf(mac);
+  return i < 0 || (long)(now - _peers[i].retryAt) >= 0;
+}
+
+bool TxRetry::failed(const uint8_t* mac, uint8_t attempts, unsigned long now) {
+  if (attempts >= _maxAttempts) {
+    done(mac);
+    return false;
+  }
+
+  uint32_t delay = (uint32_t)_backoffMs << (attempts - 1 < 16 ? attempts - 1 : 16);
+  if (delay > _maxBackoffMs) delay = _maxBackoffMs;
+
+  int8_t i = indexOf(mac);
+  Peer* p = i < 0 ? nullptr : &_peers[i];
+  if (!p) {
+    // Free slot, else the peer whose backoff ran out the longest ago
+    for (Peer& candidate : _peers) {
+      if (!candidate.used) {
+        p = &candidate;
+        break;
+      }
+      if (!p || (long)(p->retryAt - candidate.retryAt) > 0) p = &candidate;
+    }
+    p->used = true;
+    memcpy(p->mac, mac, 6);
+  }
+
+  p->retryAt = now + delay;
+  return true;
+}
+
+void TxRetry::done(const uint8_t* mac) {
+  int8_t i = indexOf(mac);
+  if (i >= 0) _peers[i].used = false;
+}
+
+int8_t TxRetry::indexOf(const uint8_t* mac) const {
+  for (int8_t i = 0; i < MAX_PEERS; ++i) {
+    if (_peers[i].used && !memcmp(_peers[i].mac, mac, 6)) return i;
+  }
+  return -1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Gateway side retry policy for ESPNOW_TX (GATEWAY_CONFIG `TX_RETRY`).
+//
+// A failed send is tried again up to maxAttempts in total, waiting
+// backoff, 2 x backoff, 4 x backoff ... (capped at maxBackoff) in between.
+// The wait applies to the peer, not just the frame, so later frames to the
+// same peer stay behind it while frames to other peers go ahead. Only the
+// final outcome is reported to the host.
+class TxRetry {
+public:
+  static constexpr uint8_t MAX_PEERS = 8;
+
+  // maxAttempts of 0 or 1 disables retries, which is the default after boot
+  void configure(uint8_t maxAttempts, uint16_t backoffMs, uint16_t maxBackoffMs);
+
+  // False while the peer waits out its backoff
+  bool ready(const uint8_t* mac, unsigned long now) const;
+
+  // After a failed attempt, true when the frame should be sent again later
+  bool failed(const uint8_t* mac, uint8_t attempts, unsigned long now);
+
+  // After the final outcome for a frame to this peer
+  void done(const uint8_t* mac);
+
+private:
+  struct Peer {
+    bool used;
+    uint8_t mac[6];
+    unsigned long retryAt;
+  };
+
+  Peer _peers[MAX_PEERS] = {};
+
+  uint8_t  _maxAttempts = 1;
+  uint16_t _backoffMs = 0;
+  uint16_t _maxBackoffMs = 0;
+
+  int8_t indexOf(const uint8_t* mac) const;
+};
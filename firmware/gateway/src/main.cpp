@@ -6,29 +6,166 @@
 #include "utils/LedBlinker.h"
 #include "serial/PacketEncoder.h"
 #include "serial/PacketDecoder.h"
+#include "serial/BaudNegotiator.h"
+#include "espnow/RxQueue.h"
+#include "espnow/RxBatch.h"
+#include "espnow/TxQueue.h"
+#include "espnow/TxMailbox.h"
+#include "espnow/TxRetry.h"
+#include "espnow/PeerTable.h"
+#include "espnow/RxFilter.h"
+#include "telemetry/GatewayStats.h"
+#include "telemetry/Profiler.h"
 
 #define ESPNOW_WIFI_CHANNEL 6
 #define SERIAL_BAUD_RATE 9600
 
+#ifndef RX_QUEUE_SIZE
+#define RX_QUEUE_SIZE 16
+#endif
+
+#ifndef TX_QUEUE_SIZE
+#define TX_QUEUE_SIZE 8
+#endif
+
+#ifndef TX_MAILBOX_SIZE
+#define TX_MAILBOX_SIZE 4
+#endif
+
+// Mail for a peer not heard from this long is failed, freeing its slot
+#ifndef TX_MAILBOX_TTL_MS
+#define TX_MAILBOX_TTL_MS (15 * 60 * 1000UL)
+#endif
+
+// onDataSent normally fires within a few ms, this only guards against losing it
+#define TX_SENT_TIMEOUT_MS 100
+
+// How long after a timed out send its late report is still waited for
+#define TX_LATE_REPORT_MS 1000
+
 PacketDecoder decoder;
+BaudNegotiator baud(SERIAL_BAUD_RATE);
 LedBlinker blinker(LED_BUILTIN);
+RxQueue<RX_QUEUE_SIZE> rxQueue;
+RxBatch rxBatch;
+TxQueue<TX_QUEUE_SIZE> txQueue;
+TxMailbox<TX_MAILBOX_SIZE> txMailbox;
+TxRetry txRetry;
+PeerTable peers;
+RxFilter rxFilter;
+GatewayStats stats;
+
+// Seq of the last ESPNOW_TX handled, the host counts its credits from it
+uint8_t lastTxSeq = 0;
+
+// Frame handed to the radio, completed by onDataSend
+TxFrame* txInFlight = nullptr;
+unsigned long txStartedAt = 0;
+volatile bool txSent = false;
+volatile uint8_t txSentStatus = 0;
+
+// onDataSent only says which peer, not which frame: after a timeout nothing
+// goes out until the late report arrived or TX_LATE_REPORT_MS passed, so it
+// cannot complete the next frame
+bool txReportOwed = false;
 
 void onDataSend(uint8_t *macaddr, uint8_t status) {
-  if (status == 0) {
-    blinker.blink(); 
-  }
+  PROFILE_SCOPE(ESPNOW_TX_CALLBACK);
 
-  PacketEncoder::sendEspNowTxStatusPacket(macaddr, status);
+  // loop() reports it, it knows which seq this was
+  txSentStatus = status;
+  txSent = true;
 }
 
 void onDataRcvd(uint8_t *macaddr, uint8_t *data, uint8_t len, signed int rssi, bool broadcast) {
-  blinker.blink(5);
+  PROFILE_SCOPE(ESPNOW_RX_CALLBACK);
+
+  // Serial is far slower than the radio, loop() forwards the frame
+  rxQueue.push(macaddr, rssi, data, len);
+}
 
-  PacketEncoder::sendEspNowPacket(macaddr, rssi, data, len);
+void onEspNowTx(const uint8_t* mac, uint8_t seq, const uint8_t* payload, uint8_t len) {
+  lastTxSeq = seq;
+
+  if (!txQueue.push(mac, seq, payload, len)) {
+    // Host ran out of credits, tell it where we really are
+    stats.add(GatewayStats::ESPNOW_TX_QUEUE_FULL);
+    PacketEncoder::sendEspNowTxStatusPacket(mac, seq, txQueue.STATUS_QUEUE_FULL);
+    PacketEncoder::sendEspNowTxCreditsPacket(txQueue.free(), lastTxSeq);
+  }
 }
 
-void onEspNowTx(const uint8_t* mac, const uint8_t* payload, uint8_t len) {
-  quickEspNow.send(mac, payload, len);
+void onEspNowTxMailbox(const uint8_t* mac, uint8_t seq, const uint8_t* payload, uint8_t len) {
+  uint8_t replaced;
+
+  switch (txMailbox.hold(mac, seq, payload, len, millis(), replaced)) {
+    case txMailbox.HELD:
+      break;
+    case txMailbox.REPLACED:
+      PacketEncoder::sendEspNowTxStatusPacket(mac, replaced, txQueue.STATUS_REPLACED);
+      break;
+    case txMailbox.FULL:
+      stats.add(GatewayStats::ESPNOW_TX_QUEUE_FULL);
+      PacketEncoder::sendEspNowTxStatusPacket(mac, seq, txQueue.STATUS_QUEUE_FULL);
+      break;
+  }
+}
+
+uint16_t readU16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+void onGatewayConfig(uint8_t key, const uint8_t* value, uint8_t len) {
+  switch (key) {
+    case PacketDecoder::CONFIG_RX_BATCH:
+      if (len >= 4) rxBatch.configure(readU16(value), readU16(value + 2));
+      break;
+    case PacketDecoder::CONFIG_TX_RETRY:
+      if (len >= 5) txRetry.configure(value[0], readU16(value + 1), readU16(value + 3));
+      break;
+    case PacketDecoder::CONFIG_STATS:
+      if (len >= 2) stats.configure(readU16(value));
+      break;
+    case PacketDecoder::CONFIG_PROFILE:
+      // A request rather than a setting: dump now, bit 0 clears afterwards
+      Profiler::send(len >= 1 && (value[0] & 0x01));
+      break;
+    case PacketDecoder::CONFIG_DEDUP:
+      if (len >= 2) peers.configure(readU16(value));
+      break;
+    case PacketDecoder::CONFIG_PEERS:
+      // A request as well
+      peers.send(millis());
+      break;
+    case PacketDecoder::CONFIG_FILTER_HITS:
+      rxFilter.send();
+      break;
+  }
+}
+
+// Answered with the (fresh) hit counters, a rejected table leaves the old ones
+void onRxFilter(const uint8_t* table, uint8_t len) {
+  rxFilter.configure(table, len);
+  rxFilter.send();
+}
+
+void onSerialBaud(uint32_t rate) {
+  baud.request(rate);
+}
+
+// What the status LED shows, sampled by the blinker once per cycle
+LedBlinker::Activity activity() {
+  const PacketDecoder::Counters& serial = decoder.counters();
+  uint8_t rxPressure = 100 * rxQueue.size() / rxQueue.capacity();
+  uint8_t txPressure = 100 * txQueue.size() / txQueue.capacity();
+
+  LedBlinker::Activity a;
+  a.frames = rxQueue.received() + stats.get(GatewayStats::ESPNOW_TX_OK) + stats.get(GatewayStats::ESPNOW_TX_FAILED);
+  a.errors = stats.get(GatewayStats::ESPNOW_TX_FAILED) + stats.get(GatewayStats::ESPNOW_TX_QUEUE_FULL) +
+             serial.crcErrors + serial.timeouts;
+  a.drops = rxQueue.overflows();
+  a.pressure = max(rxPressure, txPressure);
+  return a;
 }
 
 void setup() {
@@ -36,7 +173,7 @@ void setup() {
   Serial.begin(SERIAL_BAUD_RATE);
 
   /* Setup Blinker  */
-  blinker.setup(); 
+  blinker.setup(activity);
   
   /* Setup ESP Now */
   WiFi.mode(WIFI_STA);
@@ -48,14 +185,154 @@ void setup() {
 
   /* Setup Packet Decoder */
   decoder.onEspNowTx(onEspNowTx);
+  decoder.onEspNowTxMailbox(onEspNowTxMailbox);
+  decoder.onGatewayConfig(onGatewayConfig);
+  decoder.onSerialBaud(onSerialBaud);
+  decoder.onRxFilter(onRxFilter);
+  decoder.onVersionChange(PacketEncoder::setVersion);
 
   /* Send Gateway Init */
   uint8_t mac[6];
   WiFi.macAddress(mac);
   PacketEncoder::sendGatewayInitPacket(mac);
+  PacketEncoder::sendEspNowTxCreditsPacket(txQueue.free(), lastTxSeq);
+}
+
+void completeTx(uint8_t status) {
+  TxFrame* f = txInFlight;
+  txInFlight = nullptr;
+
+  bool mail = txMailbox.owns(f);
+
+  if (status == txQueue.STATUS_OK) {
+    txRetry.done(f->mac);
+    stats.add(GatewayStats::ESPNOW_TX_OK);
+  } else if (txRetry.failed(f->mac, f->attempts, millis())) {
+    // Stays queued, serviceTxQueue() picks it up again after the backoff
+    stats.add(GatewayStats::ESPNOW_TX_RETRIES);
+    if (mail && !txMailbox.retry(f)) {
+      PacketEncoder::sendEspNowTxStatusPacket(f->mac, f->seq, txQueue.STATUS_REPLACED);
+    }
+    return;
+  } else if (mail) {
+    // The peer went back to sleep, try again when it wakes
+    stats.add(GatewayStats::ESPNOW_TX_FAILED);
+    if (!txMailbox.keep(f)) {
+      PacketEncoder::sendEspNowTxStatusPacket(f->mac, f->seq, txQueue.STATUS_REPLACED);
+    }
+    return;
+  } else {
+    stats.add(GatewayStats::ESPNOW_TX_FAILED);
+  }
+
+  if (mail) {
+    // Mail never took a credit
+    PacketEncoder::sendEspNowTxStatusPacket(f->mac, f->seq, status);
+    txMailbox.remove(f);
+    return;
+  }
+
+  PacketEncoder::sendEspNowTxStatusPacket(f->mac, f->seq, status);
+  txQueue.remove(f);
+  PacketEncoder::sendEspNowTxCreditsPacket(txQueue.free(), lastTxSeq);
+}
+
+// One frame on air at a time, the next goes out once the last one reported
+void serviceTxQueue() {
+  unsigned long now = millis();
+
+  // The frame on air is never expired, its outcome comes first
+  while (TxFrame* expired = txMailbox.expired(now, TX_MAILBOX_TTL_MS)) {
+    PacketEncoder::sendEspNowTxStatusPacket(expired->mac, expired->seq, txQueue.STATUS_FAILED);
+    txMailbox.remove(expired);
+  }
+
+  if (txInFlight) {
+    if (txSent) {
+      completeTx(txSentStatus);
+    } else if (now - txStartedAt > TX_SENT_TIMEOUT_MS) {
+      completeTx(txQueue.STATUS_FAILED);
+      txReportOwed = true;
+    } else {
+      return;
+    }
+  }
+
+  // A late report is dropped, its frame was already failed
+  if (txReportOwed) {
+    if (!txSent && now - txStartedAt <= TX_LATE_REPORT_MS) return;
+    txReportOwed = false;
+  }
+
+  auto ready = [now](const TxFrame& f) { return txRetry.ready(f.mac, now); };
+
+  // Mail first, its peer only listens for a moment after it was heard
+  TxFrame* f = txMailbox.take(ready);
+  if (!f) {
+    f = txQueue.find(ready);
+    if (!f) return;
+    ++f->attempts;
+  }
+
+  txSent = false;
+  txInFlight = f;
+  txStartedAt = now;
+  if (quickEspNow.send(f->mac, f->data, f->len) != 0) {
+    completeTx(txQueue.STATUS_FAILED);
+  }
+}
+
+void drainRxQueue() {
+  unsigned long now = millis();
+
+  while (const RxFrame* f = rxQueue.peek()) {
+    txMailbox.heard(f->mac);
+
+    if (!rxFilter.accepts(*f) || !peers.seen(f->mac, f->rssi, f->data, f->len, now)) {
+      rxQueue.pop();
+      continue;
+    }
+
+    if (!rxBatch.enabled()) {
+      PacketEncoder::sendEspNowPacket(f->mac, f->rssi, f->data, f->len);
+    } else if (!rxBatch.add(*f, now)) {
+      rxBatch.flush();
+      if (!rxBatch.add(*f, now)) {
+        // Larger than the configured batch, send it on its own
+        PacketEncoder::sendEspNowPacket(f->mac, f->rssi, f->data, f->len);
+      }
+    }
+    rxQueue.pop();
+  }
+
+  if (rxBatch.due(now)) rxBatch.flush();
+}
+
+void reportStats() {
+  if (!stats.due(millis())) return;
+
+  const PacketDecoder::Counters& serial = decoder.counters();
+  stats.set(GatewayStats::SERIAL_FRAMES, serial.frames);
+  stats.set(GatewayStats::SERIAL_CRC_ERRORS, serial.crcErrors);
+  stats.set(GatewayStats::SERIAL_TIMEOUTS, serial.timeouts);
+  stats.set(GatewayStats::ESPNOW_RX_FRAMES, rxQueue.received());
+  stats.set(GatewayStats::ESPNOW_RX_DROPS, rxQueue.overflows());
+  stats.set(GatewayStats::ESPNOW_RX_DUPLICATES, peers.duplicates());
+  stats.set(GatewayStats::ESPNOW_RX_FILTERED, rxFilter.dropped());
+  stats.send();
+}
+
+bool parseSerial() {
+  PROFILE_SCOPE(SERIAL_PARSE);
+  return decoder.parse();
 }
 
 void loop() {
-  decoder.parse();
-  blinker.update();
+  PROFILE_SCOPE(LOOP);
+
+  drainRxQueue();
+  baud.update(parseSerial());
+  serviceTxQueue();
+  reportStats();
+  blinker.update(millis());
 }
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "BaudNegotiator.h"
+
+#include "PacketEncoder.h"
+
+bool BaudNegotiator::supported(uint32_t baud) {
+  switch (baud) {
+    case 9600:
+    case 19200:
+    case 38400:
+    case 57600:
+    case 115200:
+    case 230400:
+    case 460800:
+    case 921600:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void BaudNegotiator::request(uint32_t baud) {
+  // The host repeats its request at the new rate, update() confirms on it
+  if (state != IDLE) return;
+
+  if (!supported(baud)) {
+    PacketEncoder::sendSerialBaudAckPacket(baud, STATUS_REJECTED);
+    return;
+  }
+
+  // Same rate doubles as a keepalive / probe
+  if (baud == _baud) {
+    PacketEncoder::sendSerialBaudAckPacket(baud, STATUS_CONFIRMED);
+    return;
+  }
+
+  _requestedBaud = baud;
+  state = REQUESTED;
+}
+
+void BaudNegotiator::update(bool frameReceived) {
+  unsigned long now = millis();
+
+  switch (state) {
+    case IDLE:
+      if (frameReceived) {
+        _lastFrameTime = now;
+      } else if (_baud != _bootBaud && now - _lastFrameTime > LINK_IDLE_MS) {
+        switchTo(_bootBaud);
+        PacketEncoder::sendSerialBaudAckPacket(_baud, STATUS_REVERTED);
+      }
+      break;
+
+    case REQUESTED:
+      // Ack at the old rate and let it drain before switching
+      PacketEncoder::sendSerialBaudAckPacket(_requestedBaud, STATUS_SWITCHING);
+      Serial.flush();
+
+      _previousBaud = _baud;
+      switchTo(_requestedBaud);
+      _deadline = now + CONFIRM_TIMEOUT_MS;
+      state = PENDING;
+      break;
+
+    case PENDING:
+      if (frameReceived) {
+        PacketEncoder::sendSerialBaudAckPacket(_baud, STATUS_CONFIRMED);
+        _lastFrameTime = now;
+        state = IDLE;
+      } else if ((long)(now - _deadline) > 0) {
+        switchTo(_previousBaud);
+        PacketEncoder::sendSerialBaudAckPacket(_baud, STATUS_REVERTED);
+        _lastFrameTime = now;
+        state = IDLE;
+      }
+      break;
+  }
+}
+
+void BaudNegotiator::switchTo(uint32_t baud) {
+  Serial.flush();
+  Serial.begin(baud);
+  _baud = baud;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host driven serial baud rate switch (SERIAL_BAUD / SERIAL_BAUD_ACK).
+//
+// The gateway acks a request at the current rate, switches, and keeps the
+// new rate only if a valid frame arrives within CONFIRM_TIMEOUT_MS. At a
+// negotiated rate it also falls back to the boot rate when the host goes
+// quiet for LINK_IDLE_MS, so a host that reopened the port at the boot rate
+// can reach the gateway again.
+class BaudNegotiator {
+public:
+  static constexpr uint8_t STATUS_SWITCHING = 0x00;
+  static constexpr uint8_t STATUS_CONFIRMED = 0x01;
+  static constexpr uint8_t STATUS_REJECTED  = 0x02;
+  static constexpr uint8_t STATUS_REVERTED  = 0x03;
+
+  static constexpr uint16_t CONFIRM_TIMEOUT_MS = 1000;
+  static constexpr uint32_t LINK_IDLE_MS = 30000;
+
+  explicit BaudNegotiator(uint32_t bootBaud) : _bootBaud(bootBaud), _baud(bootBaud) {}
+
+  static bool supported(uint32_t baud);
+
+  // SERIAL_BAUD handler, the switch itself happens in update()
+  void request(uint32_t baud);
+
+  // Call every loop with whether the decoder completed a valid frame
+  void update(bool frameReceived);
+
+  uint32_t baud() const { return _baud; }
+
+private:
+  enum State {
+    IDLE,
+    REQUESTED,
+    PENDING
+  };
+
+  State state = IDLE;
+
+  const uint32_t _bootBaud;
+  uint32_t _baud;
+  uint32_t _previousBaud = 0;
+  uint32_t _requestedBaud = 0;
+
+  unsigned long _deadline = 0;
+  unsigned long _lastFrameTime = 0;
+
+  void switchTo(uint32_t baud);
+};
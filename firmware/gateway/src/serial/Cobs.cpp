@@ -0,0 +1,54 @@
+#include "Cobs.h"
+
+namespace Cobs {
+  bool decode(uint8_t* buf, size_t len, size_t& outLen) {
+    size_t r = 0, w = 0;
+
+    while (r < len) {
+      uint8_t code = buf[r++];
+      if (code == DELIMITER) return false;
+
+      for (uint8_t i = 1; i < code; ++i) {
+        if (r >= len) return false;
+        buf[w++] = buf[r++];
+      }
+
+      // A full block carries no implied zero, neither does the last one
+      if (code != 0xFF && r < len) buf[w++] = 0;
+    }
+
+    outLen = w;
+    return true;
+  }
+
+  void Writer::put(uint8_t b) {
+    if (b == 0) {
+      flush(_n + 1);
+      return;
+    }
+
+    _block[_n++] = b;
+    if (_n == sizeof(_block)) {
+      flush(0xFF);
+      _afterFullBlock = true;
+    }
+  }
+
+  void Writer::put(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) put(data[i]);
+  }
+
+  void Writer::finish() {
+    if (_n || !_afterFullBlock) flush(_n + 1);
+    Serial.write(DELIMITER);
+    _n = 0;
+    _afterFullBlock = false;
+  }
+
+  void Writer::flush(uint8_t code) {
+    Serial.write(code);
+    Serial.write(_block, _n);
+    _n = 0;
+    _afterFullBlock = false;
+  }
+}
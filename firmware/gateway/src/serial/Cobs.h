@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Consistent Overhead Byte Stuffing, frames are terminated by a 0x00 byte
+// that never appears inside an encoded frame.
+namespace Cobs {
+  static constexpr uint8_t DELIMITER = 0x00;
+
+  // Decodes in place, returns false on a malformed frame
+  bool decode(uint8_t* buf, size_t len, size_t& outLen);
+
+  // Streams an encoded frame to Serial, staging at most one 254 byte block
+  class Writer {
+  public:
+    void put(uint8_t b);
+    void put(const uint8_t* data, size_t len);
+
+    // Emits the last block and the delimiter
+    void finish();
+
+  private:
+    uint8_t _block[254];
+    uint8_t _n = 0;
+    bool _afterFullBlock = false;
+
+    void flush(uint8_t code);
+  };
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Arduino.h>
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF), used by serial V2 frames
+namespace Crc16 {
+  static constexpr uint16_t INIT = 0xFFFF;
+
+  inline uint16_t update(uint16_t crc, uint8_t b) {
+    crc ^= (uint16_t)b << 8;
+    for (uint8_t i = 0; i < 8; ++i)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+  }
+
+  inline uint16_t update(uint16_t crc, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; ++i) crc = update(crc, data[i]);
+    return crc;
+  }
+}
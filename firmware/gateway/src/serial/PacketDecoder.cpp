@@ -1,83 +1,297 @@
 #include "PacketDecoder.h"
 
+#include "Cobs.h"
+#include "Crc16.h"
+#include "espnow/RxFilter.h"
+
+constexpr PacketDecoder::Packet PacketDecoder::PACKETS[] = {
+  //  TYPE                FIXED  COUNT AT  ITEM  MAX COUNT
+  { { TYPE_GATEWAY_CONFIG,    2,        1,    1, 0xFF                }, &PacketDecoder::handleGatewayConfig },
+  { { TYPE_SERIAL_BAUD,       4                                      }, &PacketDecoder::handleSerialBaud },
+  { { TYPE_RX_FILTER,         3,        2,   17, RxFilter::MAX_RULES }, &PacketDecoder::handleRxFilter },
+  { { TYPE_ESPNOW_TX,         8,        7,    1, MAX_PAYLOAD         }, &PacketDecoder::handleEspNowTx },
+  { { TYPE_ESPNOW_TX_MAILBOX, 8,        7,    1, MAX_PAYLOAD         }, &PacketDecoder::handleEspNowTxMailbox },
+};
+
+const PacketDecoder::Packet* PacketDecoder::find(uint8_t type) {
+  static_assert(PacketType::wellFormed(PACKETS, sizeof(tdata)), "a PACKETS layout does not fit tdata");
+  static constexpr PacketIndex<PacketType::lowest(PACKETS), PacketType::highest(PACKETS)> index(PACKETS);
+  return index.find(PACKETS, type);
+}
+
 void PacketDecoder::onEspNowTx(EspNowTxHandler handler) {
   espNowTxHandler = handler;
 }
 
+void PacketDecoder::onEspNowTxMailbox(EspNowTxHandler handler) {
+  espNowTxMailboxHandler = handler;
+}
+
+void PacketDecoder::onGatewayConfig(GatewayConfigHandler handler) {
+  gatewayConfigHandler = handler;
+}
+
+void PacketDecoder::onSerialBaud(SerialBaudHandler handler) {
+  serialBaudHandler = handler;
+}
+
+void PacketDecoder::onRxFilter(RxFilterHandler handler) {
+  rxFilterHandler = handler;
+}
+
+void PacketDecoder::onVersionChange(VersionHandler handler) {
+  versionHandler = handler;
+}
+
+void PacketDecoder::setMode(Mode m) {
+  mode = m;
+}
+
 bool PacketDecoder::parse() {
+  return mode == MODE_BLOCK ? parseBlock() : parseBytes();
+}
+
+bool PacketDecoder::parseBytes() {
   while (Serial.available()) {
     unsigned long now = millis();
     if (state != WAIT_SYNC && now - lastByteTime > BYTE_TIMEOUT_MS) {
+      ++counts.timeouts;
       reset();
     }
     lastByteTime = now;
 
     uint8_t byte = Serial.read();
 
-    switch (state) {
-      case WAIT_SYNC:
-        if (byte == SYNC) {
-          state = WAIT_VERSION;
-        }
-        break;
+    // V2 frames are delimited, they resync on their own next to V1
+    if (parseV2(byte)) return true;
+    if (step(byte)) return true;
+  }
 
-      case WAIT_VERSION:
-        version = byte;
-        if (version != VERSION) {
-          reset();
-        } else {
-          state = WAIT_TYPE;
-        }
-        break;
+  return false;
+}
 
-      case WAIT_TYPE:
-        type = byte;
-        crc = version ^ type;
-        tdataLen = 0;
-        expectedLen = 0;
-        if (type == TYPE_ESPNOW_TX) {
-          state = READ_TDATA;
-        } else {
-          reset();  // Unknown type
-        }
-        break;
+bool PacketDecoder::parseBlock() {
+  fill();
 
-      case READ_TDATA:
-        tdata[tdataLen++] = byte;
-        crc ^= byte;
+  while (uint16_t count = ringHead - ringTail) {
+    uint16_t at = ringTail % RING_SIZE;
+    uint16_t span = min<uint16_t>(count, RING_SIZE - at);
 
-        if (type == TYPE_ESPNOW_TX && tdataLen >= 7 && expectedLen == 0) {
-          expectedLen = 6 + 1 + tdata[6];
-          if (expectedLen > sizeof(tdata)) {
-            reset();
-            break;
-          }
-        }
+    // Bytes after a frame stay in the ring, callers see one frame per call
+    bool handled = false;
+    ringTail += consume(ring + at, span, handled);
+    if (handled) return true;
+  }
 
-        if (expectedLen && tdataLen == expectedLen) {
-          state = WAIT_CRC;
-        }
+  return false;
+}
+
+void PacketDecoder::fill() {
+  size_t available = Serial.available();
+  if (!available) return;
+
+  // Same inter byte timeout as MODE_BYTE, checked once per chunk
+  unsigned long now = millis();
+  if (state != WAIT_SYNC && now - lastByteTime > BYTE_TIMEOUT_MS) {
+    ++counts.timeouts;
+    reset();
+  }
+  lastByteTime = now;
+
+  while (available) {
+    uint16_t free = RING_SIZE - (uint16_t)(ringHead - ringTail);
+    uint16_t at = ringHead % RING_SIZE;
+    size_t n = min<size_t>(min<size_t>(available, free), RING_SIZE - at);
+    if (!n) break;
+
+    n = Serial.readBytes(ring + at, n);
+    if (!n) break;
+
+    ringHead += n;
+    available -= n;
+  }
+}
+
+size_t PacketDecoder::consume(const uint8_t* data, size_t len, bool& handled) {
+  // V1 never has to look past a 0x00, that byte may end a V2 frame first
+  const uint8_t* delimiter = (const uint8_t*)memchr(data, Cobs::DELIMITER, len);
+  size_t segment = delimiter ? delimiter - data : len;
+
+  size_t i = 0;
+  while (i < segment && !handled) {
+    if (state == WAIT_SYNC) {
+      const uint8_t* sync = (const uint8_t*)memchr(data + i, SYNC, segment - i);
+      if (!sync) {
+        i = segment;
         break;
+      }
+      i = sync - data + 1;
+      state = WAIT_VERSION;
+    } else if (state == READ_TDATA && expectedLen) {
+      size_t n = min<size_t>(expectedLen - tdataLen, segment - i);
+      memcpy(tdata + tdataLen, data + i, n);
+      for (size_t k = 0; k < n; ++k) crc ^= data[i + k];
 
-      case WAIT_CRC:
-        state = WAIT_SYNC;
-        if (byte != crc) return false;
+      tdataLen += n;
+      i += n;
+      if (tdataLen == expectedLen) state = WAIT_CRC;
+    } else {
+      handled = step(data[i++]);
+    }
+  }
+
+  if (handled) return i;
+
+  appendV2(data, i);
+  if (!delimiter) return i;
+
+  handled = parseV2(Cobs::DELIMITER) || step(Cobs::DELIMITER);
+  return i + 1;
+}
 
-        if (type == TYPE_ESPNOW_TX && espNowTxHandler) {
-          const uint8_t* mac = tdata;
-          uint8_t len = tdata[6];
-          const uint8_t* payload = tdata + 7;
-          espNowTxHandler(mac, payload, len);
+bool PacketDecoder::step(uint8_t byte) {
+  switch (state) {
+    case WAIT_SYNC:
+      if (byte == SYNC) {
+        state = WAIT_VERSION;
+      }
+      break;
+
+    case WAIT_VERSION:
+      version = byte;
+      if (version != VERSION) {
+        reset();
+      } else {
+        state = WAIT_TYPE;
+      }
+      break;
+
+    case WAIT_TYPE:
+      packet = find(byte);
+      crc = version ^ byte;
+      tdataLen = 0;
+      if (packet) {
+        expectedLen = packet->layout.length(tdata, 0);
+        state = READ_TDATA;
+      } else {
+        reset();  // Unknown type
+      }
+      break;
+
+    case READ_TDATA:
+      tdata[tdataLen++] = byte;
+      crc ^= byte;
+
+      if (!expectedLen) {
+        expectedLen = packet->layout.length(tdata, tdataLen);
+        if (expectedLen == PacketType::INVALID) {
+          reset();
+          break;
         }
-        Serial.write(crc);
+      }
 
-        return true;
-    }
+      if (expectedLen && tdataLen == expectedLen) {
+        state = WAIT_CRC;
+      }
+      break;
+
+    case WAIT_CRC:
+      state = WAIT_SYNC;
+      if (byte != crc) {
+        ++counts.crcErrors;
+        return false;
+      }
+
+      dispatch(VERSION, *packet, tdata);
+      Serial.write(crc);
+
+      return true;
   }
 
   return false;
 }
 
+void PacketDecoder::appendV2(const uint8_t* data, size_t len) {
+  size_t n = min(len, sizeof(v2buf) - v2Len);
+  memcpy(v2buf + v2Len, data, n);
+  v2Len += n;
+  if (n < len) v2Overflow = true;
+}
+
+bool PacketDecoder::parseV2(uint8_t byte) {
+  if (byte != Cobs::DELIMITER) {
+    appendV2(&byte, 1);
+    return false;
+  }
+
+  size_t len = v2Len;
+  bool overflow = v2Overflow;
+  v2Len = 0;
+  v2Overflow = false;
+
+  // <VERSION><TYPE><TDATA...><CRC16 LE>
+  if (overflow || !Cobs::decode(v2buf, len, len) || len < 4) return false;
+  if (v2buf[0] != VERSION_2) return false;
+
+  uint16_t expected = v2buf[len - 2] | (v2buf[len - 1] << 8);
+  if (Crc16::update(Crc16::INIT, v2buf, len - 2) != expected) {
+    ++counts.crcErrors;
+    return false;
+  }
+
+  const Packet* framePacket = find(v2buf[1]);
+  const uint8_t* frameData = v2buf + 2;
+  if (!framePacket || !framePacket->layout.valid(frameData, len - 4)) return false;
+
+  dispatch(VERSION_2, *framePacket, frameData);
+  return true;
+}
+
+void PacketDecoder::dispatch(uint8_t frameVersion, const Packet& packet, const uint8_t* tdata) {
+  ++counts.frames;
+
+  // A valid frame ends whatever the other version's parser had half read
+  if (frameVersion == VERSION) {
+    v2Len = 0;
+    v2Overflow = false;
+  } else {
+    reset();
+  }
+
+  if (frameVersion != lastVersion) {
+    lastVersion = frameVersion;
+    if (versionHandler) versionHandler(frameVersion);
+  }
+
+  (this->*packet.handle)(tdata);
+}
+
+// <MAC(6)><SEQ><LEN><PAYLOAD(LEN)>
+void PacketDecoder::handleEspNowTx(const uint8_t* tdata) {
+  if (espNowTxHandler) espNowTxHandler(tdata, tdata[6], tdata + 8, tdata[7]);
+}
+
+void PacketDecoder::handleEspNowTxMailbox(const uint8_t* tdata) {
+  if (espNowTxMailboxHandler) espNowTxMailboxHandler(tdata, tdata[6], tdata + 8, tdata[7]);
+}
+
+// <KEY><LEN><VALUE(LEN)>
+void PacketDecoder::handleGatewayConfig(const uint8_t* tdata) {
+  if (gatewayConfigHandler) gatewayConfigHandler(tdata[0], tdata + 2, tdata[1]);
+}
+
+// <BAUD(4) LE>
+void PacketDecoder::handleSerialBaud(const uint8_t* tdata) {
+  if (!serialBaudHandler) return;
+  uint32_t baud = tdata[0] | (tdata[1] << 8) | ((uint32_t)tdata[2] << 16) | ((uint32_t)tdata[3] << 24);
+  serialBaudHandler(baud);
+}
+
+// <DEFAULT><MIN_RSSI><COUNT><COUNT x RULE(17)>
+void PacketDecoder::handleRxFilter(const uint8_t* tdata) {
+  if (rxFilterHandler) rxFilterHandler(tdata, 3 + tdata[2] * 17);
+}
+
 void PacketDecoder::reset() {
   state = WAIT_SYNC;
   tdataLen = 0;
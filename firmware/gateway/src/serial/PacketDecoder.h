@@ -2,21 +2,85 @@
 
 #include <Arduino.h>
 
+#include "PacketType.h"
+
 class PacketDecoder {
 public:
   static constexpr uint8_t SYNC = 0xAA;
   static constexpr uint8_t VERSION = 0x01;
+  static constexpr uint8_t VERSION_2 = 0x02;
 
+  static constexpr uint8_t TYPE_GATEWAY_CONFIG = 0x10;
+  static constexpr uint8_t TYPE_SERIAL_BAUD = 0x11;
+  static constexpr uint8_t TYPE_RX_FILTER = 0x12;
   static constexpr uint8_t TYPE_ESPNOW_TX = 0x21;
+  static constexpr uint8_t TYPE_ESPNOW_TX_MAILBOX = 0x25;
+
+  /* GATEWAY_CONFIG keys */
+  static constexpr uint8_t CONFIG_RX_BATCH = 0x01;
+  static constexpr uint8_t CONFIG_TX_RETRY = 0x02;
+  static constexpr uint8_t CONFIG_STATS = 0x03;
+  static constexpr uint8_t CONFIG_PROFILE = 0x04;
+  static constexpr uint8_t CONFIG_DEDUP = 0x05;
+  static constexpr uint8_t CONFIG_PEERS = 0x06;
+  static constexpr uint8_t CONFIG_FILTER_HITS = 0x07;
+
+  // ESP-NOW payload limit, longer ESPNOW_TX frames are dropped
+  static constexpr uint8_t MAX_PAYLOAD = 250;
 
-  using EspNowTxHandler = void (*)(const uint8_t mac[6], const uint8_t* payload, uint8_t len);
+  // BYTE reads and handles one byte per Serial call, BLOCK pulls everything
+  // available into a ring first and copies payloads with memcpy
+  enum Mode {
+    MODE_BYTE,
+    MODE_BLOCK
+  };
+  void setMode(Mode mode);
+
+  using EspNowTxHandler = void (*)(const uint8_t mac[6], uint8_t seq, const uint8_t* payload, uint8_t len);
   void onEspNowTx(EspNowTxHandler handler);
+  // Same layout as ESPNOW_TX, held until the peer is heard
+  void onEspNowTxMailbox(EspNowTxHandler handler);
+
+  using GatewayConfigHandler = void (*)(uint8_t key, const uint8_t* value, uint8_t len);
+  void onGatewayConfig(GatewayConfigHandler handler);
 
+  using SerialBaudHandler = void (*)(uint32_t baud);
+  void onSerialBaud(SerialBaudHandler handler);
 
+  // Whole RX_FILTER TDATA, see RxFilter::configure
+  using RxFilterHandler = void (*)(const uint8_t* table, uint8_t len);
+  void onRxFilter(RxFilterHandler handler);
+
+  // Called before the handlers of the first valid frame in a new version
+  using VersionHandler = void (*)(uint8_t version);
+  void onVersionChange(VersionHandler handler);
+
+  // Reads what is available, true once a valid frame (V1 or V2) was handled
   bool parse();
 
+  // A V1 frame still unfinished after this long without a byte is dropped
+  static constexpr uint16_t BYTE_TIMEOUT_MS = 10;
+
+  // Monotonic since boot, reported in GATEWAY_STATS
+  struct Counters {
+    uint32_t frames = 0;    // valid frames handled
+    uint32_t crcErrors = 0; // frames that parsed but failed their CRC
+    uint32_t timeouts = 0;  // V1 frames abandoned by the byte timeout
+  };
+  const Counters& counters() const { return counts; }
+
+  // A V1 frame's TDATA is being read, watched by the resync benchmark
+  bool readingTdata() const { return state == READ_TDATA; }
+
 private:
+  Mode mode = MODE_BLOCK;
+
   EspNowTxHandler espNowTxHandler = nullptr;
+  EspNowTxHandler espNowTxMailboxHandler = nullptr;
+  GatewayConfigHandler gatewayConfigHandler = nullptr;
+  SerialBaudHandler serialBaudHandler = nullptr;
+  RxFilterHandler rxFilterHandler = nullptr;
+  VersionHandler versionHandler = nullptr;
 
   enum State {
     WAIT_SYNC,
@@ -27,16 +91,52 @@ private:
   };
 
   State state = WAIT_SYNC;
+  Counters counts;
+
+  // One host -> gateway packet type: its layout and the method handing it on
+  struct Packet {
+    PacketType layout;
+    void (PacketDecoder::*handle)(const uint8_t* tdata);
+  };
+  static const Packet PACKETS[];
+  static const Packet* find(uint8_t type);
 
   uint8_t version = 0;
-  uint8_t type = 0;
-  uint8_t tdata[256];
-  uint8_t tdataLen = 0;
-  uint8_t expectedLen = 0;
+  const Packet* packet = nullptr; // V1 frame being read
+  uint8_t tdata[6 + 1 + 1 + MAX_PAYLOAD]; // ESPNOW_TX is the largest, every PACKETS layout is checked to fit
+  uint16_t tdataLen = 0;
+  uint16_t expectedLen = 0;
   uint8_t crc = 0;
 
   unsigned long lastByteTime = 0;
-  static constexpr uint16_t BYTE_TIMEOUT_MS = 10;
+
+  /* MODE_BLOCK: bytes read from Serial but not consumed yet */
+  static constexpr uint16_t RING_SIZE = 512;
+  uint8_t ring[RING_SIZE];
+  uint16_t ringHead = 0;
+  uint16_t ringTail = 0;
+
+  /* V2: COBS frame accumulated up to the 0x00 delimiter */
+  static constexpr size_t V2_MAX_FRAME = 1 + 1 + 256 + 2 + 4; // VER + TYPE + TDATA + CRC16 + COBS overhead
+  uint8_t v2buf[V2_MAX_FRAME];
+  size_t v2Len = 0;
+  bool v2Overflow = false;
+
+  uint8_t lastVersion = VERSION;
 
   void reset();
+  bool parseBytes();
+  bool parseBlock();
+  void fill();
+  size_t consume(const uint8_t* data, size_t len, bool& handled);
+  bool step(uint8_t byte);
+  void appendV2(const uint8_t* data, size_t len);
+  bool parseV2(uint8_t byte);
+  void dispatch(uint8_t version, const Packet& packet, const uint8_t* tdata);
+
+  void handleEspNowTx(const uint8_t* tdata);
+  void handleEspNowTxMailbox(const uint8_t* tdata);
+  void handleGatewayConfig(const uint8_t* tdata);
+  void handleSerialBaud(const uint8_t* tdata);
+  void handleRxFilter(const uint8_t* tdata);
 };
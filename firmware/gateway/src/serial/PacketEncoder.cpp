@@ -1,22 +1,85 @@
 #include "PacketEncoder.h"
 
+#include "Cobs.h"
+#include "Crc16.h"
+#include "PacketType.h"
+
+namespace {
+    // Gateway -> host packets made of a fixed part, COUNT last, then COUNT
+    // little endian u32 items. { TYPE, FIXED, COUNT AT, ITEM, MAX COUNT }
+    constexpr PacketType GATEWAY_STATS   = { PacketEncoder::TYPE_GATEWAY_STATS,   4 + 4 + 1,          8,        4,    32 };
+    constexpr PacketType GATEWAY_PROFILE = { PacketEncoder::TYPE_GATEWAY_PROFILE, 1 + 1 + 4 * 4 + 1,  18,       4,    33 };
+    constexpr PacketType RX_FILTER_HITS  = { PacketEncoder::TYPE_RX_FILTER_HITS,  4 + 4 + 1,          8,        4,    32 };
+
+    constexpr uint8_t MAX_ITEMS = 33;
+    static_assert(GATEWAY_STATS.maxCount <= MAX_ITEMS && GATEWAY_PROFILE.maxCount <= MAX_ITEMS &&
+                  RX_FILTER_HITS.maxCount <= MAX_ITEMS, "u32 items do not fit MAX_ITEMS");
+}
+
+uint8_t PacketEncoder::version = PacketEncoder::VERSION;
+
+void PacketEncoder::setVersion(uint8_t v) {
+    version = (v == VERSION_2) ? VERSION_2 : VERSION;
+}
+
 void PacketEncoder::sendGatewayInitPacket(
     const uint8_t* mac
 ) {
-    uint8_t buffer[10]; // SYNC + VER + TYPE + MAC(6) + CRC
+    const Segment segments[] = { { mac, 6 } };
+    sendFrame(TYPE_GATEWAY_INIT, segments);
+}
+
+void PacketEncoder::sendSerialBaudAckPacket(
+    uint32_t baud,
+    uint8_t status
+) {
+    uint8_t buffer[5]; // BAUD(4) + STATUS
     uint8_t idx = 0;
 
-    buffer[idx++] = SYNC_BYTE;
-    buffer[idx++] = VERSION;
-    buffer[idx++] = TYPE_GATEWAY_INIT;
+    // BAUD (4B, little endian)
+    writeU32(&buffer[idx], baud);
+    idx += 4;
 
-    memcpy(&buffer[idx], mac, 6);
-    idx += 6;
+    buffer[idx++] = status;
+
+    const Segment segments[] = { { buffer, idx } };
+    sendFrame(TYPE_SERIAL_BAUD_ACK, segments);
+}
 
-    uint8_t crc = crc8(&buffer[1], idx - 1);
-    buffer[idx++] = crc;
+void PacketEncoder::sendGatewayStatsPacket(
+    uint32_t uptimeMs,
+    uint32_t freeHeap,
+    const uint32_t* counters,
+    uint8_t count
+) {
+    uint8_t fixed[GATEWAY_STATS.fixedLen]; // UPTIME + FREE_HEAP + COUNT
+    writeU32(&fixed[0], uptimeMs);
+    writeU32(&fixed[4], freeHeap);
 
-    Serial.write(buffer, idx);
+    sendItems(GATEWAY_STATS, fixed, counters, count);
+}
+
+void PacketEncoder::sendGatewayProfilePacket(
+    uint8_t probe,
+    uint8_t cpuMhz,
+    uint32_t samples,
+    uint32_t max,
+    uint32_t p50,
+    uint32_t p99,
+    const uint32_t* buckets,
+    uint8_t count
+) {
+    uint8_t fixed[GATEWAY_PROFILE.fixedLen]; // PROBE + CPU_MHZ + SAMPLES + MAX + P50 + P99 + COUNT
+    uint8_t idx = 0;
+
+    fixed[idx++] = probe;
+    fixed[idx++] = cpuMhz;
+    for (uint32_t value : { samples, max, p50, p99 }) {
+        writeU32(&fixed[idx], value);
+        idx += 4;
+    }
+
+    sendItems(GATEWAY_PROFILE, fixed, buckets, count);
 }
 
 void PacketEncoder::sendEspNowPacket(
@@ -25,55 +88,138 @@ void PacketEncoder::sendEspNowPacket(
     const uint8_t* data,
     uint8_t len
 ) {
-    uint8_t buffer[256];
-    uint8_t idx = 0;
-
-    buffer[idx++] = SYNC_BYTE;
-    buffer[idx++] = VERSION;
-    buffer[idx++] = TYPE_ESPNOW_RX;
+    uint8_t header[8];
 
     // MAC (6B)
-    memcpy(&buffer[idx], mac, 6);
-    idx += 6;
+    memcpy(header, mac, 6);
 
     // RSSI (1B)
-    buffer[idx++] = static_cast<uint8_t>(rssi); // store as unsigned
+    header[6] = static_cast<uint8_t>(rssi); // store as unsigned
 
     // LEN (1B)
-    buffer[idx++] = len;
+    header[7] = len;
 
-    // DATA
-    memcpy(&buffer[idx], data, len);
-    idx += len;
+    // DATA is written straight from the caller's buffer
+    const Segment segments[] = { { header, sizeof(header) }, { data, len } };
+    sendFrame(TYPE_ESPNOW_RX, segments);
+}
 
-    // CRC8 from VERSION to end of DATA
-    uint8_t crc = crc8(&buffer[1], idx - 1);
-    buffer[idx++] = crc;
+void PacketEncoder::sendGatewayPeersPacket(
+    uint8_t count,
+    const uint8_t* records,
+    size_t len
+) {
+    const Segment segments[] = { { &count, 1 }, { records, len } };
+    sendFrame(TYPE_GATEWAY_PEERS, segments);
+}
 
-    // Send to serial
-    Serial.write(buffer, idx);
+void PacketEncoder::sendRxFilterHitsPacket(
+    uint32_t rssiHits,
+    uint32_t defaultHits,
+    const uint32_t* hits,
+    uint8_t count
+) {
+    uint8_t fixed[RX_FILTER_HITS.fixedLen]; // RSSI_HITS + DEFAULT_HITS + COUNT
+    writeU32(&fixed[0], rssiHits);
+    writeU32(&fixed[4], defaultHits);
+
+    sendItems(RX_FILTER_HITS, fixed, hits, count);
+}
+
+void PacketEncoder::sendEspNowBatchPacket(
+    uint8_t count,
+    const uint8_t* records,
+    size_t len
+) {
+    // Records are already laid out by the caller, write them in place
+    const Segment segments[] = { { &count, 1 }, { records, len } };
+    sendFrame(TYPE_ESPNOW_RX_BATCH, segments);
 }
 
 void PacketEncoder::sendEspNowTxStatusPacket(
     const uint8_t* mac,
+    uint8_t seq,
     uint8_t status
 ) {
-    uint8_t buffer[10]; // SYNC + VER + TYPE + MAC(6) + STATUS + CRC
+    uint8_t buffer[8]; // MAC(6) + SEQ + STATUS
     uint8_t idx = 0;
 
-    buffer[idx++] = SYNC_BYTE;
-    buffer[idx++] = VERSION;
-    buffer[idx++] = TYPE_ESPNOW_TX_STATUS;
-
     memcpy(&buffer[idx], mac, 6);
     idx += 6;
 
+    buffer[idx++] = seq;
     buffer[idx++] = status;
 
-    uint8_t crc = crc8(&buffer[1], idx - 1);
-    buffer[idx++] = crc;
+    const Segment segments[] = { { buffer, idx } };
+    sendFrame(TYPE_ESPNOW_TX_STATUS, segments);
+}
+
+void PacketEncoder::sendEspNowTxCreditsPacket(
+    uint8_t free,
+    uint8_t seq
+) {
+    uint8_t buffer[2] = { free, seq };
+
+    const Segment segments[] = { { buffer, sizeof(buffer) } };
+    sendFrame(TYPE_ESPNOW_TX_CREDITS, segments);
+}
+
+void PacketEncoder::sendFrame(
+    uint8_t type,
+    const Segment* segments,
+    size_t count
+) {
+    if (version == VERSION) {
+        // <SYNC><VERSION><TYPE><TDATA><CRC8>
+        uint8_t header[3] = { SYNC_BYTE, VERSION, type };
+        uint8_t crc = VERSION ^ type;
+
+        Serial.write(header, sizeof(header));
+        for (size_t i = 0; i < count; ++i) {
+            crc ^= crc8(segments[i].data, segments[i].len);
+            if (segments[i].len) Serial.write(segments[i].data, segments[i].len);
+        }
+        Serial.write(crc);
+        return;
+    }
+
+    // COBS(<VERSION><TYPE><TDATA><CRC16 LE>) 0x00
+    uint16_t crc = Crc16::update(Crc16::INIT, VERSION_2);
+    crc = Crc16::update(crc, type);
+
+    Cobs::Writer w;
+    w.put(VERSION_2);
+    w.put(type);
+    for (size_t i = 0; i < count; ++i) {
+        crc = Crc16::update(crc, segments[i].data, segments[i].len);
+        w.put(segments[i].data, segments[i].len);
+    }
+    w.put(crc & 0xFF);
+    w.put(crc >> 8);
+    w.finish();
+}
+
+void PacketEncoder::sendItems(
+    const PacketType& layout,
+    uint8_t* fixed,
+    const uint32_t* items,
+    uint8_t count
+) {
+    if (count > layout.maxCount) count = layout.maxCount;
+    fixed[layout.countAt] = count;
+
+    uint8_t body[4 * MAX_ITEMS];
+    for (uint8_t i = 0; i < count; ++i) writeU32(&body[4 * i], items[i]);
+
+    const Segment segments[] = { { fixed, layout.fixedLen }, { body, 4u * count } };
+    sendFrame(layout.type, segments);
+}
 
-    Serial.write(buffer, idx);
+void PacketEncoder::writeU32(uint8_t* out, uint32_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
 }
 
 uint8_t PacketEncoder::crc8(const uint8_t* data, size_t len) {
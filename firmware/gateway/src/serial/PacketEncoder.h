@@ -2,19 +2,72 @@
 
 #include <Arduino.h>
 
+#include "PacketType.h"
+
 class PacketEncoder {
 public:
     static constexpr uint8_t SYNC_BYTE = 0xAA;
     static constexpr uint8_t VERSION   = 0x01;
+    static constexpr uint8_t VERSION_2 = 0x02;
 
     static constexpr uint8_t TYPE_GATEWAY_INIT = 0x01;
+    static constexpr uint8_t TYPE_SERIAL_BAUD_ACK = 0x02;
+    static constexpr uint8_t TYPE_GATEWAY_STATS = 0x03;
+    static constexpr uint8_t TYPE_GATEWAY_PROFILE = 0x04;
+    static constexpr uint8_t TYPE_GATEWAY_PEERS = 0x05;
+    static constexpr uint8_t TYPE_RX_FILTER_HITS = 0x06;
     static constexpr uint8_t TYPE_ESPNOW_RX = 0x20;
     static constexpr uint8_t TYPE_ESPNOW_TX_STATUS = 0x22;
+    static constexpr uint8_t TYPE_ESPNOW_RX_BATCH = 0x23;
+    static constexpr uint8_t TYPE_ESPNOW_TX_CREDITS = 0x24;
+
+    // Framing used for every packet, follows the host (PacketDecoder::version)
+    static void setVersion(uint8_t v);
 
     static void sendGatewayInitPacket(
         const uint8_t* mac
     );
 
+    static void sendSerialBaudAckPacket(
+        uint32_t baud,
+        uint8_t status
+    );
+
+    // counters: see GatewayStats::Counter
+    static void sendGatewayStatsPacket(
+        uint32_t uptimeMs,
+        uint32_t freeHeap,
+        const uint32_t* counters,
+        uint8_t count
+    );
+
+    // Summary and the first `count` buckets of one Profiler probe, in cycles
+    static void sendGatewayProfilePacket(
+        uint8_t probe,
+        uint8_t cpuMhz,
+        uint32_t samples,
+        uint32_t max,
+        uint32_t p50,
+        uint32_t p99,
+        const uint32_t* buckets,
+        uint8_t count
+    );
+
+    // records: COUNT x <MAC(6)><AGE_MS(4)><RSSI(1)><FRAMES(4)><DUPLICATES(4)>
+    static void sendGatewayPeersPacket(
+        uint8_t count,
+        const uint8_t* records,
+        size_t len
+    );
+
+    // hits: one per RX_FILTER rule, in table order
+    static void sendRxFilterHitsPacket(
+        uint32_t rssiHits,
+        uint32_t defaultHits,
+        const uint32_t* hits,
+        uint8_t count
+    );
+
     static void sendEspNowPacket(
         const uint8_t* mac,
         int8_t rssi,
@@ -22,11 +75,57 @@ public:
         uint8_t len
     );
 
+    // records: COUNT x <MAC(6)><RSSI(1)><LEN(1)><DATA(LEN)>
+    static void sendEspNowBatchPacket(
+        uint8_t count,
+        const uint8_t* records,
+        size_t len
+    );
+
+    // seq: the ESPNOW_TX this status belongs to
     static void sendEspNowTxStatusPacket(
         const uint8_t* mac,
+        uint8_t seq,
         uint8_t status
     );
 
+    // free: empty TX queue slots right after handling ESPNOW_TX `seq`
+    static void sendEspNowTxCreditsPacket(
+        uint8_t free,
+        uint8_t seq
+    );
+
+    // One piece of TDATA, written to Serial where it lies
+    struct Segment {
+        const uint8_t* data;
+        size_t len;
+    };
+
+    // Frames TDATA given as consecutive segments, the CRC is computed while
+    // writing so nothing is staged
+    static void sendFrame(
+        uint8_t type,
+        const Segment* segments,
+        size_t count
+    );
+
+    template<size_t N>
+    static void sendFrame(uint8_t type, const Segment (&segments)[N]) {
+        sendFrame(type, segments, N);
+    }
+
 private:
+    static uint8_t version;
+
+    // <FIXED><COUNT x U32 LE>, COUNT (a byte of FIXED) is capped at the
+    // layout's maxCount and written here
+    static void sendItems(
+        const PacketType& layout,
+        uint8_t* fixed,
+        const uint32_t* items,
+        uint8_t count
+    );
+
+    static void writeU32(uint8_t* out, uint32_t value);
     static uint8_t crc8(const uint8_t* data, size_t len);
 };
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+
+// TDATA layout of one packet type as far as framing cares: a fixed part,
+// optionally followed by COUNT items of one size, COUNT being a byte of the
+// fixed part. Shared by PacketDecoder and PacketEncoder so lengths, limits
+// and type lookup come from one table per direction instead of branches.
+struct PacketType {
+  static constexpr uint8_t NO_COUNT = 0xFF;
+  static constexpr uint16_t INVALID = 0xFFFF;
+
+  uint8_t type;
+  uint8_t fixedLen;       // COUNT included, never 0
+  uint8_t countAt = NO_COUNT;
+  uint8_t itemLen = 0;
+  uint8_t maxCount = 0;
+
+  constexpr uint16_t maxLength() const {
+    return fixedLen + itemLen * maxCount;
+  }
+
+  // Full TDATA length given its first `have` bytes: 0 until COUNT is in,
+  // INVALID when COUNT is past maxCount
+  constexpr uint16_t length(const uint8_t* tdata, size_t have) const {
+    return countAt == NO_COUNT ? fixedLen
+         : have <= countAt ? 0
+         : tdata[countAt] > maxCount ? INVALID
+         : fixedLen + itemLen * tdata[countAt];
+  }
+
+  constexpr bool valid(const uint8_t* tdata, size_t len) const {
+    return len >= fixedLen && length(tdata, len) == len;
+  }
+
+  // A table's entries as far as the rest of its layouts go
+  template<typename T, size_t N>
+  static constexpr bool wellFormed(const T (&table)[N], size_t maxTdata) {
+    for (size_t i = 0; i < N; ++i) {
+      const PacketType& t = table[i].layout;
+      if (!t.fixedLen || t.maxLength() > maxTdata) return false;
+      if (t.countAt != NO_COUNT && t.countAt >= t.fixedLen) return false;
+      for (size_t j = 0; j < i; ++j)
+        if (table[j].layout.type == t.type) return false;
+    }
+    return true;
+  }
+
+  template<typename T, size_t N>
+  static constexpr uint8_t lowest(const T (&table)[N]) {
+    uint8_t low = 0xFF;
+    for (size_t i = 0; i < N; ++i) low = table[i].layout.type < low ? table[i].layout.type : low;
+    return low;
+  }
+
+  template<typename T, size_t N>
+  static constexpr uint8_t highest(const T (&table)[N]) {
+    uint8_t high = 0;
+    for (size_t i = 0; i < N; ++i) high = table[i].layout.type > high ? table[i].layout.type : high;
+    return high;
+  }
+};
+
+// Type byte -> table entry without a search, one byte per type between the
+// lowest and the highest in the table
+template<uint8_t First, uint8_t Last>
+struct PacketIndex {
+  uint8_t slot[Last - First + 1] = {}; // entry + 1, 0 for unknown types
+
+  template<typename T, size_t N>
+  constexpr PacketIndex(const T (&table)[N]) {
+    for (size_t i = 0; i < N; ++i) slot[table[i].layout.type - First] = i + 1;
+  }
+
+  template<typename T, size_t N>
+  const T* find(const T (&table)[N], uint8_t type) const {
+    if (type < First || type > Last) return nullptr;
+    uint8_t i = slot[type - First];
+    return i ? &table[i - 1] : nullptr;
+  }
+};
@@ -0,0 +1,42 @@
+#include "CycleHistogram.h"
+
+uint32_t CycleHistogram::percentile(uint8_t p) const {
+  uint32_t n = samples();
+  uint32_t top = _max;
+  if (!n) return 0;
+
+  // Rank of the sample we are after, 1 based
+  uint32_t rank = ((uint64_t)n * p + 99) / 100;
+  if (!rank) rank = 1;
+
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < BUCKETS; ++i) {
+    seen += _buckets[i];
+    if (seen < rank) continue;
+
+    uint32_t upper = i == 0 ? 0 : i == 32 ? UINT32_MAX : (1UL << i) - 1;
+    return min(upper, top);
+  }
+  return top;
+}
+
+uint8_t CycleHistogram::used() const {
+  uint8_t n = BUCKETS;
+  while (n && !_buckets[n - 1]) --n;
+  return n;
+}
+
+void CycleHistogram::clear() {
+  for (uint8_t i = 0; i < BUCKETS; ++i) _buckets[i] = 0;
+  _samples = 0;
+  _max = 0;
+}
+
+void CycleHistogram::halve() {
+  uint32_t n = 0;
+  for (uint8_t i = 0; i < BUCKETS; ++i) {
+    _buckets[i] = _buckets[i] / 2;
+    n += _buckets[i];
+  }
+  _samples = n;
+}
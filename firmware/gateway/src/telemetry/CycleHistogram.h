@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Durations in CPU cycles, log2 bucketed: bucket 0 holds 0, bucket i holds
+// [2^(i-1), 2^i). Recording is a clz and two increments, cheap enough for ISRs.
+//
+// One writer per histogram. When the total would overflow all buckets are
+// halved, the shape (and so the percentiles) survives long uptimes and sums
+// over buckets stay within uint32_t.
+class CycleHistogram {
+public:
+  static constexpr uint8_t BUCKETS = 33;
+
+  void record(uint32_t cycles) {
+    uint8_t i = cycles ? 32 - __builtin_clz(cycles) : 0;
+    ++_buckets[i];
+    if (++_samples == UINT32_MAX) halve();
+    if (cycles > _max) _max = cycles;
+  }
+
+  uint32_t samples() const { return _samples; }
+  uint32_t max() const { return _max; }
+
+  // Upper bound of the bucket the p-th percentile (0-100) falls in, capped at max()
+  uint32_t percentile(uint8_t p) const;
+
+  // Buckets up to and including the last non empty one
+  uint8_t used() const;
+  uint32_t bucket(uint8_t i) const { return _buckets[i]; }
+
+  void clear();
+
+private:
+  volatile uint32_t _buckets[BUCKETS] = {};
+  volatile uint32_t _samples = 0; // sum of _buckets
+  volatile uint32_t _max = 0;
+
+  void halve();
+};
@@ -0,0 +1,19 @@
+#include "GatewayStats.h"
+
+#include "serial/PacketEncoder.h"
+
+void GatewayStats::configure(uint16_t intervalS) {
+  _intervalMs = intervalS * 1000UL;
+  _lastSentAt = millis();
+}
+
+bool GatewayStats::due(unsigned long now) {
+  if (!_intervalMs || now - _lastSentAt < _intervalMs) return false;
+
+  _lastSentAt = now;
+  return true;
+}
+
+void GatewayStats::send() const {
+  PacketEncoder::sendGatewayStatsPacket(millis(), ESP.getFreeHeap(), _counters, COUNTERS);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Health counters sent to the host as GATEWAY_STATS every interval
+// (GATEWAY_CONFIG `STATS`). All counters are monotonic since boot.
+class GatewayStats {
+public:
+  // Position in the packet, append only so older hosts keep their mapping
+  enum Counter : uint8_t {
+    SERIAL_FRAMES,        // valid frames from the host
+    SERIAL_CRC_ERRORS,    // frames dropped on a CRC mismatch
+    SERIAL_TIMEOUTS,      // frames abandoned mid way by the byte timeout
+    ESPNOW_RX_FRAMES,     // frames from the radio
+    ESPNOW_RX_DROPS,      // of those, lost because the RX queue was full
+    ESPNOW_TX_OK,         // ESPNOW_TX delivered
+    ESPNOW_TX_FAILED,     // ESPNOW_TX given up on, retries included
+    ESPNOW_TX_RETRIES,    // extra radio sends made by TxRetry
+    ESPNOW_TX_QUEUE_FULL, // ESPNOW_TX refused for lack of a free slot
+    ESPNOW_RX_DUPLICATES, // frames from the radio dropped by PeerTable
+    ESPNOW_RX_FILTERED,   // frames from the radio dropped by RxFilter
+    COUNTERS
+  };
+
+  // 0 disables the report, which is the default after boot
+  void configure(uint16_t intervalS);
+
+  void add(Counter c, uint32_t n = 1) { _counters[c] += n; }
+  void set(Counter c, uint32_t value) { _counters[c] = value; }
+  uint32_t get(Counter c) const { return _counters[c]; }
+
+  // True once per interval
+  bool due(unsigned long now);
+
+  void send() const;
+
+private:
+  uint32_t _counters[COUNTERS] = {};
+
+  uint32_t _intervalMs = 0;
+  unsigned long _lastSentAt = 0;
+};
@@ -0,0 +1,28 @@
+#include "Profiler.h"
+
+#include "serial/PacketEncoder.h"
+
+#if GATEWAY_PROFILING
+
+CycleHistogram Profiler::histograms[PROBES];
+
+void Profiler::send(bool clear) {
+  for (uint8_t p = 0; p < PROBES; ++p) {
+    CycleHistogram& h = histograms[p];
+
+    uint32_t buckets[CycleHistogram::BUCKETS];
+    uint8_t used = h.used();
+    for (uint8_t i = 0; i < used; ++i) buckets[i] = h.bucket(i);
+
+    PacketEncoder::sendGatewayProfilePacket(
+      p, ESP.getCpuFreqMHz(), h.samples(), h.max(), h.percentile(50), h.percentile(99), buckets, used);
+
+    if (clear) h.clear();
+  }
+}
+
+#else
+
+void Profiler::send(bool) {}
+
+#endif
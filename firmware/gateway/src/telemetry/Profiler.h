@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "CycleHistogram.h"
+
+// Build with -DGATEWAY_PROFILING=0 to remove the probes and their RAM
+#ifndef GATEWAY_PROFILING
+#define GATEWAY_PROFILING 1
+#endif
+
+// Cycle histograms of the gateway hot paths, sent to the host as one
+// GATEWAY_PROFILE per probe when it asks (GATEWAY_CONFIG `PROFILE`)
+class Profiler {
+public:
+  // Position in the packet, append only like GatewayStats::Counter
+  enum Probe : uint8_t {
+    LOOP,               // one loop() pass
+    SERIAL_PARSE,       // decoder.parse(), frame handlers included
+    ESPNOW_RX_CALLBACK, // onDataRcvd
+    ESPNOW_TX_CALLBACK, // onDataSend
+    PROBES
+  };
+
+  // Records the cycles spent in the enclosing block
+  class Scope {
+  public:
+    explicit Scope(Probe probe) : _probe(probe), _start(ESP.getCycleCount()) {}
+    ~Scope() { histograms[_probe].record(ESP.getCycleCount() - _start); }
+
+  private:
+    Probe _probe;
+    uint32_t _start;
+  };
+
+  // Nothing is sent when profiling is compiled out
+  static void send(bool clear);
+
+private:
+  static CycleHistogram histograms[PROBES];
+};
+
+#if GATEWAY_PROFILING
+#define PROFILE_SCOPE(probe) Profiler::Scope profileScope(Profiler::probe)
+#else
+#define PROFILE_SCOPE(probe) do {} while (0)
+#endif
@@ -1,26 +1,45 @@
 #include "LedBlinker.h"
 
+LedBlinker::LedBlinker(int ledPin) : _ledPin(ledPin) {}
 
-LedBlinker::LedBlinker(int ledPin, unsigned long blinkDuration)
-    : _ledPin(ledPin), _blinkDuration(blinkDuration), _lastLedOnTime(0), _isBlinking(false) {}
+void LedBlinker::setup(Sampler sample) {
+  _sample = sample;
+  _last = sample();
 
-void LedBlinker::setup() {
   pinMode(_ledPin, OUTPUT);
   digitalWrite(_ledPin, HIGH);
 }
 
-void LedBlinker::blink(unsigned long duration) {
-  digitalWrite(_ledPin, LOW);
-  _lastLedOnTime = millis();
-  _isBlinking = true;
+void LedBlinker::update(unsigned long now) {
+  if (now - _slotStartedAt < SLOT_MS) return;
+  _slotStartedAt = now;
 
-  // If a specific duration is provided, use it; otherwise, use the default
-  _blinkDuration = (duration > 0) ? duration : _blinkDuration;
-}
+  if (++_slot == SLOTS) {
+    _slot = 0;
 
-void LedBlinker::update() {
-  if (_isBlinking && (millis() - _lastLedOnTime > _blinkDuration)) {
-      digitalWrite(_ledPin, HIGH); // Turn LED off (active high)
-      _isBlinking = false; // Reset blink state
+    Activity a = _sample();
+    _pattern = choose(a);
+    _last = a;
   }
-}
\ No newline at end of file
+
+  write(_pattern & (1u << _slot));
+}
+
+uint16_t LedBlinker::choose(const Activity& a) const {
+  if (a.drops != _last.drops || a.pressure >= 75) return OVERLOADED;
+  if (a.errors != _last.errors) return ERRORS;
+
+  // Frames per cycle, 1.6 s
+  uint32_t frames = a.frames - _last.frames;
+  if (frames >= 160) return TRAFFIC_HIGH;
+  if (frames >= 16) return TRAFFIC;
+  if (frames) return TRAFFIC_LOW;
+  return HEARTBEAT;
+}
+
+// Only on a change, most slots leave the pin alone
+void LedBlinker::write(bool on) {
+  if (on == _on) return;
+  _on = on;
+  digitalWrite(_ledPin, on ? LOW : HIGH);
+}
@@ -2,16 +2,55 @@
 
 #include <Arduino.h>
 
+// Gateway status LED (active low). The radio callbacks never touch it, the
+// frames they handle are counted by the queues and loop() anyway. Every
+// 1.6 s cycle update() samples those counters and plays one pattern for
+// the next cycle, so the LED keeps meaning something under load:
+//
+//   heartbeat   one flash                 nothing moved
+//   traffic     2, 4 or 8 even flashes    radio frames, >= 1, 10 or 100 per s
+//   errors      a double flash            TX failures, refused ESPNOW_TX, serial errors
+//   overloaded  0.8 s on, 0.8 s off       RX frames dropped, or a queue 3/4 full
+//
+// When several apply the later one in this list wins.
 class LedBlinker {
 public:
-    LedBlinker(int ledPin, unsigned long blinkDuration = 10); 
-    void setup();
-    void blink(unsigned long duration = 0);
-    void update();
+    // Counters since boot, except pressure
+    struct Activity {
+        uint32_t frames;  // radio frames received and sent
+        uint32_t errors;
+        uint32_t drops;   // radio frames lost to a full RX queue
+        uint8_t pressure; // fullest queue, percent
+    };
+    using Sampler = Activity (*)();
+
+    LedBlinker(int ledPin);
+    void setup(Sampler sample);
+
+    // Call every loop(), only does work when a 100 ms slot ends
+    void update(unsigned long now);
 
 private:
+    static constexpr unsigned long SLOT_MS = 100;
+    static constexpr uint8_t SLOTS = 16;
+
+    /* Bit i lights the LED during slot i */
+    static constexpr uint16_t HEARTBEAT    = 0x0001;
+    static constexpr uint16_t TRAFFIC_LOW  = 0x0101;
+    static constexpr uint16_t TRAFFIC      = 0x1111;
+    static constexpr uint16_t TRAFFIC_HIGH = 0x5555;
+    static constexpr uint16_t ERRORS       = 0x0005;
+    static constexpr uint16_t OVERLOADED   = 0x00FF;
+
     int _ledPin;
-    unsigned long _blinkDuration;
-    unsigned long _lastLedOnTime;
-    bool _isBlinking;
+    Sampler _sample = nullptr;
+    Activity _last = {};
+
+    uint16_t _pattern = HEARTBEAT;
+    uint8_t _slot = 0;
+    unsigned long _slotStartedAt = 0;
+    bool _on = false;
+
+    uint16_t choose(const Activity& now) const;
+    void write(bool on);
 };
@@ -0,0 +1,90 @@
+// Mailbox slots across failed sends and newer frames, native only:
+//
+//   pio test -e native
+
+#include <unity.h>
+
+#include "espnow/TxMailbox.h"
+
+static const uint8_t PEER[6] = {0x8c, 0xaa, 0xb5, 0x52, 0xcf, 0x10};
+static const uint8_t A[] = {'A'};
+static const uint8_t B[] = {'B'};
+
+static TxMailbox<4>* mailbox;
+
+static bool anyReady(const TxFrame&) { return true; }
+
+static uint8_t hold(uint8_t seq, const uint8_t* data) {
+  uint8_t replaced = 0;
+  TEST_ASSERT_NOT_EQUAL(TxMailbox<4>::FULL, mailbox->hold(PEER, seq, data, 1, 0, replaced));
+  return replaced;
+}
+
+// Wakes the peer and takes its mail as the radio would
+static TxFrame* wake() {
+  mailbox->heard(PEER);
+  return mailbox->take(anyReady);
+}
+
+void setUp() {
+  mailbox = new TxMailbox<4>();
+}
+
+void tearDown() {
+  delete mailbox;
+}
+
+void test_newer_frame_replaces_a_held_one() {
+  hold(1, A);
+  TEST_ASSERT_EQUAL(1, hold(2, B));
+  TEST_ASSERT_EQUAL(1, mailbox->size());
+
+  TxFrame* f = wake();
+  TEST_ASSERT_EQUAL(2, f->seq);
+}
+
+void test_retry_sends_the_same_frame_again() {
+  hold(1, A);
+  TxFrame* f = wake();
+  TEST_ASSERT_TRUE(mailbox->retry(f));
+
+  TxFrame* again = mailbox->take(anyReady);
+  TEST_ASSERT_TRUE(again == f);
+  TEST_ASSERT_EQUAL(2, again->attempts);
+}
+
+void test_retry_drops_a_frame_replaced_while_on_air() {
+  hold(1, A);
+  TxFrame* a = wake();
+  hold(2, B);
+  TEST_ASSERT_EQUAL(2, mailbox->size());
+
+  TEST_ASSERT_FALSE(mailbox->retry(a));
+  TEST_ASSERT_EQUAL(1, mailbox->size());
+
+  // Only B goes out on the next wake, and only once
+  TxFrame* f = wake();
+  TEST_ASSERT_NOT_NULL(f);
+  TEST_ASSERT_EQUAL(2, f->seq);
+  TEST_ASSERT_EQUAL('B', f->data[0]);
+  TEST_ASSERT_NULL(mailbox->take(anyReady));
+}
+
+void test_keep_drops_a_frame_replaced_while_on_air() {
+  hold(1, A);
+  TxFrame* a = wake();
+  hold(2, B);
+
+  TEST_ASSERT_FALSE(mailbox->keep(a));
+  TEST_ASSERT_EQUAL(1, mailbox->size());
+  TEST_ASSERT_EQUAL(2, wake()->seq);
+}
+
+int main(int, char**) {
+  UNITY_BEGIN();
+  RUN_TEST(test_newer_frame_replaces_a_held_one);
+  RUN_TEST(test_retry_sends_the_same_frame_again);
+  RUN_TEST(test_retry_drops_a_frame_replaced_while_on_air);
+  RUN_TEST(test_keep_drops_a_frame_replaced_while_on_air);
+  return UNITY_END();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Enough of the ESP8266 WiFi core for the gateway's setup() in the simulator
+#define WIFI_STA 1
+
+namespace Sim {
+  // Locally administered, devices send their frames here
+  constexpr uint8_t GATEWAY_MAC[6] = {0x02, 0x00, 0x00, 0x00, 0xff, 0xfe};
+}
+
+class ESP8266WiFiClass {
+public:
+  void mode(int) {}
+  void disconnect(bool) {}
+  uint8_t* macAddress(uint8_t* mac) {
+    memcpy(mac, Sim::GATEWAY_MAC, 6);
+    return mac;
+  }
+};
+
+extern ESP8266WiFiClass WiFi;
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+
+// The part of QuickESPNow the gateway uses, its radio is a node of the
+// simulated Medium (src/Radio.cpp)
+typedef void (*comms_hal_rcvd_data)(uint8_t* address, uint8_t* data, uint8_t len, signed int rssi, bool broadcast);
+typedef void (*comms_hal_sent_data)(uint8_t* address, uint8_t status);
+
+typedef enum {
+  COMMS_SEND_OK = 0,
+  COMMS_SEND_PARAM_ERROR = -1,
+  COMMS_SEND_PAYLOAD_LENGTH_ERROR = -2,
+  COMMS_SEND_QUEUE_FULL_ERROR = -3
+} comms_send_error_t;
+
+class Medium;
+
+class QuickEspNow {
+public:
+  bool begin(uint8_t channel = 255, uint32_t interface = 0, bool synchronousSend = true);
+  comms_send_error_t send(const uint8_t* dstAddress, const uint8_t* payload, size_t payload_len);
+  void onDataRcvd(comms_hal_rcvd_data cb) { _rcvd = cb; }
+  void onDataSent(comms_hal_sent_data cb) { _sent = cb; }
+  bool readyToSendData();
+  uint8_t getMaxMessageLength() { return 250; }
+
+  /* Sim side: the medium begin() attaches to */
+  void use(Medium* medium) { _medium = medium; }
+
+private:
+  Medium* _medium = nullptr;
+  uint16_t _node = 0;
+  comms_hal_rcvd_data _rcvd = nullptr;
+  comms_hal_sent_data _sent = nullptr;
+};
+
+extern QuickEspNow quickEspNow;
@@ -0,0 +1,188 @@
+#include "Fleet.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+#include <ESP8266WiFi.h>
+#include <NowLink.h>
+#include <components/BinarySensor.h>
+#include <components/MonochromaticLight.h>
+#include <components/Switch.h>
+
+#include "Medium.h"
+
+namespace {
+  Medium* clockMedium = nullptr;
+
+  uint32_t clock() {
+    return clockMedium->now() / 1000;
+  }
+
+  // Makes a device's instance the selected one for the scope
+  struct Selected {
+    NowLink::Instance* previous;
+    explicit Selected(NowLink::Instance* instance) : previous(NowLink::select(instance)) {}
+    ~Selected() { NowLink::select(previous); }
+  };
+}
+
+double Delivery::percentile(double p) {
+  if (latencies.empty()) return 0;
+  size_t i = std::min(latencies.size() - 1, size_t(p * latencies.size()));
+  std::nth_element(latencies.begin(), latencies.begin() + i, latencies.end());
+  return latencies[i] / 1000.0;
+}
+
+struct Fleet::Device {
+  struct Entity {
+    std::unique_ptr<NowEntity> owned;
+    NowBinarySensor* sensor = nullptr;
+    NowSwitch* sw = nullptr;
+    NowMonochromaticLight* light = nullptr;
+
+    // Last event or command not yet seen by the host
+    bool pending = false;
+    bool value = false;
+    uint64_t since = 0;
+  };
+
+  std::string id;
+  uint8_t mac[6];
+  uint16_t node;
+  NowLink::Instance* link;
+  std::vector<Entity> entities; // by handle
+
+  template<typename T>
+  T* add(const char* name) {
+    T* e = new T(name);
+    entities.emplace_back();
+    entities.back().owned.reset(e);
+    return e;
+  }
+};
+
+Fleet::Fleet(Medium& medium, const Config& config) : _medium(medium), _rng(config.seed) {
+  clockMedium = &medium;
+  std::uniform_int_distribution<int> rssi(-90, -40);
+
+  for (uint16_t i = 0; i < config.devices; ++i) {
+    _devices.emplace_back(new Device());
+    Device& d = *_devices.back();
+
+    char id[16];
+    snprintf(id, sizeof(id), "sim_%04u", i);
+    d.id = id;
+    const uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, uint8_t(i >> 8), uint8_t(i)};
+    memcpy(d.mac, mac, 6);
+    d.link = NowLink::create();
+
+    auto receive = [&d](const uint8_t*, const uint8_t* data, uint8_t len, int8_t, bool) {
+      Selected s(d.link);
+      NowLink::handlePacket(data, len);
+    };
+    auto sent = [&d](const uint8_t*, bool delivered) {
+      Selected s(d.link);
+      NowLink::handleSendStatus(delivered);
+    };
+    d.node = medium.attach(d.mac, rssi(_rng), receive, sent);
+
+    // Entities register with the selected instance as they are built, the
+    // mix follows the example devices
+    Selected s(d.link);
+    switch (i % 3) {
+      case 0: // two-way switch
+        d.add<NowBinarySensor>("flash_button");
+        d.add<NowSwitch>("led_switch");
+        break;
+      case 1: // light with a motion sensor
+        d.add<NowMonochromaticLight>("desk_lamp");
+        d.add<NowBinarySensor>("motion");
+        break;
+      default:
+        d.add<NowBinarySensor>("contact");
+        break;
+    }
+    for (Device::Entity& e : d.entities) {
+      e.sensor = dynamic_cast<NowBinarySensor*>(e.owned.get());
+      e.sw = dynamic_cast<NowSwitch*>(e.owned.get());
+      e.light = dynamic_cast<NowMonochromaticLight*>(e.owned.get());
+    }
+
+    NowLink::setClock(clock);
+    NowLink::begin(d.id.c_str());
+    NowLink::setCodec(config.msgpack ? NowLink::CODEC_MSGPACK : NowLink::CODEC_JSON);
+    NowLink::setDeliveryTracking(true);
+    uint16_t node = d.node;
+    NowLink::setSendCallback([this, node](const uint8_t* data, size_t len) {
+      return _medium.send(node, Sim::GATEWAY_MAC, data, len);
+    });
+  }
+}
+
+Fleet::~Fleet() {}
+
+void Fleet::loop() {
+  for (auto& d : _devices) {
+    Selected s(d->link);
+    NowLink::loop();
+  }
+}
+
+void Fleet::event() {
+  Device& d = *_devices[std::uniform_int_distribution<size_t>(0, _devices.size() - 1)(_rng)];
+
+  for (Device::Entity& e : d.entities) {
+    if (!e.sensor) continue;
+
+    Selected s(d.link);
+    e.sensor->setState(!e.sensor->state());
+    e.pending = true;
+    e.value = e.sensor->state();
+    e.since = _medium.now();
+    ++uplink.generated;
+    return;
+  }
+}
+
+bool Fleet::command(const uint8_t*& mac, uint8_t& handle, bool& on) {
+  // A few random picks, busy fleets mostly have idle entities
+  for (uint8_t tries = 0; tries < 8; ++tries) {
+    Device& d = *_devices[std::uniform_int_distribution<size_t>(0, _devices.size() - 1)(_rng)];
+
+    for (uint8_t h = 0; h < d.entities.size(); ++h) {
+      Device::Entity& e = d.entities[h];
+      if (e.sensor || e.pending) continue;
+
+      mac = d.mac;
+      handle = h;
+      on = e.sw ? !e.sw->state() : !e.light->isOn();
+      e.pending = true;
+      e.value = on;
+      e.since = _medium.now();
+      ++downlink.generated;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Fleet::observe(const uint8_t* mac, uint8_t handle, bool on) {
+  Device* d = find(mac);
+  if (!d || handle >= d->entities.size()) return;
+
+  Device::Entity& e = d->entities[handle];
+  if (!e.pending || e.value != on) return;
+
+  e.pending = false;
+  Delivery& delivery = e.sensor ? uplink : downlink;
+  ++delivery.delivered;
+  delivery.latencies.push_back(_medium.now() - e.since);
+}
+
+Fleet::Device* Fleet::find(const uint8_t* mac) {
+  if (memcmp(mac, "\x02\x00\x00\x00", 4)) return nullptr;
+  size_t i = (mac[4] << 8) | mac[5];
+  return i < _devices.size() ? _devices[i].get() : nullptr;
+}
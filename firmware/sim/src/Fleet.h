@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+class Medium;
+
+// Outcome of the events of one direction, latencies in us
+struct Delivery {
+  uint32_t generated = 0;
+  uint32_t delivered = 0;
+  std::vector<uint32_t> latencies;
+
+  double ratio() const { return generated ? double(delivered) / generated : 1; }
+
+  // In ms, 0 when nothing was delivered
+  double percentile(double p);
+};
+
+// Virtual NowLink devices, each running the real components on its own
+// NowLink::Instance and radio node. Sensors change on their own (uplink),
+// switches and lights take commands from the host (downlink). An event is
+// delivered once the host sees the state it produced, a sensor changing
+// again before that counts its previous event as lost.
+class Fleet {
+public:
+  struct Config {
+    uint16_t devices = 10;
+    bool msgpack = false;
+    uint32_t seed = 1;
+  };
+
+  Fleet(Medium& medium, const Config& config);
+  ~Fleet();
+
+  // Every device's NowLink::loop(), once per virtual ms
+  void loop();
+
+  // Flips a random sensor
+  void event();
+
+  // A switch or light with no command outstanding, whose state the host
+  // should set to `on`. False when every one of them is waiting
+  bool command(const uint8_t*& mac, uint8_t& handle, bool& on);
+
+  // A state the host received
+  void observe(const uint8_t* mac, uint8_t handle, bool on);
+
+  Delivery uplink;
+  Delivery downlink;
+
+private:
+  struct Device;
+
+  Medium& _medium;
+  std::vector<std::unique_ptr<Device>> _devices;
+  std::mt19937 _rng;
+
+  Device* find(const uint8_t* mac);
+};
@@ -0,0 +1,229 @@
+#include "Host.h"
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <NowConstants.h>
+
+#include <algorithm>
+
+#include "Fleet.h"
+#include "Medium.h"
+#include "serial/Cobs.h"
+#include "serial/Crc16.h"
+#include "serial/PacketDecoder.h"
+#include "serial/PacketEncoder.h"
+
+namespace {
+  constexpr uint8_t BROADCAST[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+  void putU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value);
+    out.push_back(value >> 8);
+  }
+
+  uint32_t readU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+}
+
+// 8N1, ten bits on the line per byte
+Host::Host(Medium& medium, Fleet& fleet, const Config& config)
+    : _medium(medium), _fleet(fleet), _config(config), _byteUs(10e6 / config.baud) {}
+
+void Host::begin() {
+  Bytes batch;
+  putU16(batch, _config.batchBytes);
+  putU16(batch, _config.batchAgeMs);
+  config(PacketDecoder::CONFIG_RX_BATCH, batch);
+
+  Bytes retry = {3};
+  putU16(retry, 5);
+  putU16(retry, 100);
+  config(PacketDecoder::CONFIG_TX_RETRY, retry);
+
+  Bytes dedup;
+  putU16(dedup, _config.dedupMs);
+  config(PacketDecoder::CONFIG_DEDUP, dedup);
+
+  Bytes stats;
+  putU16(stats, 1);
+  config(PacketDecoder::CONFIG_STATS, stats);
+
+  if (_config.rediscoverMs) {
+    char payload[32];
+    snprintf(payload, sizeof(payload), "{\".t\":\"d\",\"w\":%u}", _config.rediscoverMs);
+    espNowTx(BROADCAST, payload);
+  }
+}
+
+void Host::command(const uint8_t* mac, uint8_t handle, bool on) {
+  char payload[32];
+  snprintf(payload, sizeof(payload), "{\"n\":%u,\"stat\":\"%s\"}", handle, on ? "ON" : "OFF");
+  espNowTx(mac, payload);
+}
+
+void Host::update() {
+  double now = _medium.now();
+
+  // What the gateway wrote since the last call queues behind the line
+  const std::vector<uint8_t>& written = Serial.tx();
+  if (written.size() > _rxSeen) {
+    size_t n = written.size() - _rxSeen;
+    double start = std::max(_rxFreeAt, now);
+    _counters.maxBacklogUs = std::max<uint32_t>(_counters.maxBacklogUs, start - now);
+    _counters.rxBusyUs += n * _byteUs;
+    _rxFreeAt = start + n * _byteUs;
+    _rxLine.push_back({_rxFreeAt, Bytes(written.begin() + _rxSeen, written.end())});
+    _rxSeen = written.size();
+  }
+
+  while (!_rxLine.empty() && _rxLine.front().readyAt <= now) {
+    receive(_rxLine.front().bytes.data(), _rxLine.front().bytes.size());
+    _rxLine.pop_front();
+  }
+
+  while (!_txLine.empty() && _txLine.front().readyAt <= now) {
+    Serial.inject(_txLine.front().bytes.data(), _txLine.front().bytes.size());
+    _txLine.pop_front();
+  }
+}
+
+bool Host::stalled() const {
+  return _rxFreeAt - _medium.now() > UART_FIFO * _byteUs;
+}
+
+// COBS(<VERSION><TYPE><TDATA><CRC16 LE>) 0x00
+void Host::send(uint8_t type, const Bytes& tdata) {
+  Bytes raw = {PacketDecoder::VERSION_2, type};
+  raw.insert(raw.end(), tdata.begin(), tdata.end());
+  putU16(raw, Crc16::update(Crc16::INIT, raw.data(), raw.size()));
+
+  Bytes out;
+  size_t codeAt = 0;
+  bool afterFullBlock = false;
+  out.push_back(1);
+  for (uint8_t b : raw) {
+    if (b != 0) {
+      out.push_back(b);
+      afterFullBlock = false;
+      if (++out[codeAt] != 0xFF) continue;
+      afterFullBlock = true;
+    }
+    codeAt = out.size();
+    out.push_back(1);
+  }
+  if (afterFullBlock) out.pop_back();
+  out.push_back(0);
+
+  double now = _medium.now();
+  double start = std::max(_txFreeAt, now);
+  _counters.txBusyUs += out.size() * _byteUs;
+  _txFreeAt = start + out.size() * _byteUs;
+  _txLine.push_back({_txFreeAt, std::move(out)});
+}
+
+void Host::config(uint8_t key, const Bytes& value) {
+  Bytes tdata = {key, uint8_t(value.size())};
+  tdata.insert(tdata.end(), value.begin(), value.end());
+  send(PacketDecoder::TYPE_GATEWAY_CONFIG, tdata);
+}
+
+// <MAC(6)><SEQ><LEN><PAYLOAD>, the seq is set when it goes out
+void Host::espNowTx(const uint8_t* mac, const char* payload) {
+  Bytes tdata(mac, mac + 6);
+  tdata.push_back(0);
+  tdata.push_back(strlen(payload));
+  tdata.insert(tdata.end(), payload, payload + strlen(payload));
+
+  if (!_credits || !_commands.empty()) ++_counters.creditWaits;
+  _commands.push_back(std::move(tdata));
+  pumpCommands();
+}
+
+void Host::pumpCommands() {
+  while (_credits && !_commands.empty()) {
+    Bytes& tdata = _commands.front();
+    tdata[6] = ++_seq;
+    --_credits;
+    send(PacketDecoder::TYPE_ESPNOW_TX, tdata);
+    _commands.pop_front();
+  }
+}
+
+void Host::receive(const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (data[i] != Cobs::DELIMITER) {
+      _frame.push_back(data[i]);
+      continue;
+    }
+
+    // Frames the gateway sent in V1 before the switch fail here
+    size_t n;
+    if (_frame.size() >= 2 && Cobs::decode(_frame.data(), _frame.size(), n) && n >= 4 &&
+        _frame[0] == PacketEncoder::VERSION_2 &&
+        Crc16::update(Crc16::INIT, _frame.data(), n - 2) == (_frame[n - 2] | (_frame[n - 1] << 8))) {
+      ++_counters.frames;
+      handleFrame(_frame[1], _frame.data() + 2, n - 4);
+    }
+    _frame.clear();
+  }
+}
+
+void Host::handleFrame(uint8_t type, const uint8_t* tdata, size_t len) {
+  switch (type) {
+    case PacketEncoder::TYPE_ESPNOW_RX:
+      if (len >= 8 && len == 8u + tdata[7]) handleEspNow(tdata, tdata + 8, tdata[7]);
+      break;
+
+    case PacketEncoder::TYPE_ESPNOW_RX_BATCH: {
+      // COUNT x <MAC(6)><RSSI(1)><LEN(1)><DATA(LEN)>
+      size_t idx = 1;
+      for (uint8_t i = 0; len && i < tdata[0] && idx + 8 <= len; ++i) {
+        uint8_t n = tdata[idx + 7];
+        if (idx + 8 + n > len) break;
+        handleEspNow(tdata + idx, tdata + idx + 8, n);
+        idx += 8 + n;
+      }
+      break;
+    }
+
+    case PacketEncoder::TYPE_ESPNOW_TX_CREDITS:
+      // Credits as of `seq`, frames sent after it still hold theirs
+      if (len >= 2) {
+        _credits = std::max(0, tdata[0] - uint8_t(_seq - tdata[1]));
+        pumpCommands();
+      }
+      break;
+
+    case PacketEncoder::TYPE_GATEWAY_STATS:
+      if (len >= 9 && len == 9u + 4 * tdata[8]) {
+        _stats.resize(tdata[8]);
+        for (uint8_t i = 0; i < tdata[8]; ++i) _stats[i] = readU32(tdata + 9 + 4 * i);
+      }
+      break;
+  }
+}
+
+void Host::handleEspNow(const uint8_t* mac, const uint8_t* data, uint8_t len) {
+  ++_counters.espNowFrames;
+  if (!len) return;
+
+  JsonDocument doc;
+  DeserializationError err = data[0] == NowConstants::Codec::MSGPACK_MARKER
+    ? deserializeMsgPack(doc, data + 1, len - 1)
+    : deserializeJson(doc, data, len);
+  if (err) return;
+
+  namespace K = NowConstants::Keys;
+  namespace T = NowConstants::Types;
+
+  const char* type = doc[K::TYPE] | "";
+  if (!strcmp(type, T::DISCOVERY)) {
+    ++_counters.discoveries;
+  } else if (!strcmp(type, T::STATE)) {
+    _fleet.observe(mac, doc[K::HANDLE] | 0xFF, !strcmp(doc[K::STATE] | "", "ON"));
+  } else if (!strcmp(type, T::BATCH)) {
+    for (JsonObjectConst s : doc[K::STATES].as<JsonArrayConst>())
+      _fleet.observe(mac, s[K::HANDLE] | 0xFF, !strcmp(s[K::STATE] | "", "ON"));
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <deque>
+#include <vector>
+
+class Fleet;
+class Medium;
+
+// The host end of the gateway's serial link. Bytes the gateway writes reach
+// the host once the UART got them across at `baud`, frames the host sends
+// reach the gateway the same way. Speaks SERIAL_V2, configures the gateway
+// the way the host app does on GATEWAY_INIT and passes the NowLink states it
+// receives to the Fleet.
+class Host {
+public:
+  struct Config {
+    uint32_t baud = 115200;
+    uint16_t batchBytes = 256; // RX_BATCH, 0 forwards frames one by one
+    uint16_t batchAgeMs = 20;
+    uint16_t dedupMs = 200;
+    uint16_t rediscoverMs = 3000; // window of the broadcast rediscover
+  };
+
+  struct Counters {
+    uint64_t rxBusyUs = 0;    // gateway -> host line busy
+    uint64_t txBusyUs = 0;    // host -> gateway
+    uint32_t maxBacklogUs = 0; // longest a gateway write waited for the line
+    uint32_t frames = 0;      // valid frames from the gateway
+    uint32_t espNowFrames = 0; // ESP-NOW frames they carried
+    uint32_t discoveries = 0;
+    uint32_t creditWaits = 0; // commands held for lack of TX credits
+  };
+
+  Host(Medium& medium, Fleet& fleet, const Config& config);
+
+  // Gateway configuration and a broadcast rediscover, as after GATEWAY_INIT
+  void begin();
+
+  // ESPNOW_TX {"n":handle,"stat":..} once a credit is free
+  void command(const uint8_t* mac, uint8_t handle, bool on);
+
+  // Call after every gateway loop(), moves what is due over the UART
+  void update();
+
+  // The gateway's Serial.write() blocks while the UART FIFO is full, and
+  // its loop() with it (the radio callbacks still run)
+  bool stalled() const;
+
+  const Counters& counters() const { return _counters; }
+  void resetCounters() { _counters = {}; }
+
+  // Counters of the last GATEWAY_STATS, see GatewayStats::Counter
+  const std::vector<uint32_t>& gatewayStats() const { return _stats; }
+
+private:
+  using Bytes = std::vector<uint8_t>;
+
+  // Gateway boot credits (TX_QUEUE_SIZE), its TX_CREDITS at boot go out in
+  // V1 before the host switched the link to V2
+  static constexpr uint8_t BOOT_CREDITS = 8;
+
+  // ESP8266 UART TX FIFO, the core does not buffer beyond it
+  static constexpr size_t UART_FIFO = 128;
+
+  struct Chunk {
+    double readyAt;
+    Bytes bytes;
+  };
+
+  Medium& _medium;
+  Fleet& _fleet;
+  Config _config;
+  double _byteUs;
+
+  // gateway -> host
+  size_t _rxSeen = 0;
+  double _rxFreeAt = 0;
+  std::deque<Chunk> _rxLine;
+  Bytes _frame;
+
+  // host -> gateway
+  double _txFreeAt = 0;
+  std::deque<Chunk> _txLine;
+  std::deque<Bytes> _commands; // ESPNOW_TX TDATA waiting for a credit
+  uint8_t _credits = BOOT_CREDITS;
+  uint8_t _seq = 0;
+
+  Counters _counters;
+  std::vector<uint32_t> _stats;
+
+  void send(uint8_t type, const Bytes& tdata);
+  void config(uint8_t key, const Bytes& value);
+  void espNowTx(const uint8_t* mac, const char* payload);
+  void pumpCommands();
+
+  void receive(const uint8_t* data, size_t len);
+  void handleFrame(uint8_t type, const uint8_t* tdata, size_t len);
+  void handleEspNow(const uint8_t* mac, const uint8_t* data, uint8_t len);
+};
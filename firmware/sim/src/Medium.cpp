@@ -0,0 +1,165 @@
+#include "Medium.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+Medium::Medium(const Config& config) : _config(config), _rng(config.seed) {}
+
+uint16_t Medium::attach(const uint8_t mac[6], int8_t rssi, Receive receive, Sent sent) {
+  _nodes.emplace_back();
+  Node& n = _nodes.back();
+  memcpy(n.mac, mac, 6);
+  n.rssi = rssi;
+  n.receive = std::move(receive);
+  n.sent = std::move(sent);
+  return _nodes.size() - 1;
+}
+
+bool Medium::send(uint16_t node, const uint8_t dst[6], const uint8_t* data, uint8_t len) {
+  Node& n = _nodes[node];
+  if (n.busy || len > sizeof(n.data)) return false;
+
+  n.busy = true;
+  memcpy(n.dst, dst, 6);
+  memcpy(n.data, data, len);
+  n.len = len;
+  n.attempts = 0;
+  n.cw = CW_MIN;
+  backoff(node, _now);
+  return true;
+}
+
+bool Medium::busy(uint16_t node) const {
+  return _nodes[node].busy;
+}
+
+void Medium::advance(uint64_t until) {
+  while (!_events.empty() && _events.top().at <= until) {
+    Event e = _events.top();
+    _events.pop();
+    _now = e.at;
+
+    switch (e.type) {
+      case TRY_START:
+        tryStart(e.node);
+        break;
+      case TX_END:
+        end(e.node);
+        break;
+      case STATUS:
+        if (e.ok) {
+          finish(e.node, true);
+        } else if (_nodes[e.node].attempts < _config.retries) {
+          Node& n = _nodes[e.node];
+          ++n.attempts;
+          n.cw = std::min<uint16_t>(2 * n.cw + 1, CW_MAX);
+          backoff(e.node, _now);
+        } else {
+          ++_counters.failed;
+          finish(e.node, false);
+        }
+        break;
+    }
+  }
+  _now = until;
+}
+
+void Medium::schedule(uint64_t at, EventType type, uint16_t node, bool ok) {
+  _events.push({at, _order++, type, node, ok});
+}
+
+// DIFS after the channel went idle, then a random number of slots
+void Medium::backoff(uint16_t node, uint64_t from) {
+  uint16_t slots = std::uniform_int_distribution<uint16_t>(0, _nodes[node].cw)(_rng);
+  schedule(std::max(from, _idleAt) + DIFS_US + slots * SLOT_US, TRY_START, node);
+}
+
+void Medium::tryStart(uint16_t node) {
+  if (_now < _idleAt) {
+    // Frames that started less than a slot ago cannot be sensed yet
+    bool sensed = _onAir.empty();
+    for (uint16_t other : _onAir)
+      sensed = sensed || _now - _nodes[other].startedAt >= SLOT_US;
+    if (sensed) {
+      backoff(node, _idleAt);
+      return;
+    }
+  }
+
+  Node& n = _nodes[node];
+  n.startedAt = _now;
+  n.collided = false;
+  for (uint16_t other : _onAir) {
+    _nodes[other].collided = true;
+    n.collided = true;
+  }
+  _onAir.push_back(node);
+
+  uint32_t us = airtime(n.len);
+  ++_counters.frames;
+  occupy(_now, _now + us);
+  schedule(_now + us, TX_END, node);
+}
+
+void Medium::end(uint16_t node) {
+  _onAir.erase(std::find(_onAir.begin(), _onAir.end(), node));
+
+  Node& n = _nodes[node];
+  bool toAll = broadcast(n.dst);
+  uint64_t ackTimeout = _now + SIFS_US + ACK_US + SLOT_US;
+
+  if (n.collided) {
+    ++_counters.collisions;
+    if (toAll) finish(node, true);
+    else schedule(ackTimeout, STATUS, node);
+    return;
+  }
+
+  if (toAll) {
+    for (uint16_t i = 0; i < _nodes.size(); ++i)
+      if (i != node && received()) _nodes[i].receive(n.mac, n.data, n.len, n.rssi, true);
+    finish(node, true);
+    return;
+  }
+
+  Node* dst = nullptr;
+  for (Node& candidate : _nodes)
+    if (!memcmp(candidate.mac, n.dst, 6)) dst = &candidate;
+
+  if (!dst || !received()) {
+    schedule(ackTimeout, STATUS, node);
+    return;
+  }
+
+  dst->receive(n.mac, n.data, n.len, n.rssi, false);
+
+  // The ack follows after SIFS, before anyone else's DIFS runs out
+  uint64_t ackEnd = _now + SIFS_US + ACK_US;
+  occupy(ackEnd - ACK_US, ackEnd);
+  if (received()) schedule(ackEnd, STATUS, node, true);
+  else schedule(ackTimeout, STATUS, node);
+}
+
+// Overlapping frames count once
+void Medium::occupy(uint64_t from, uint64_t to) {
+  if (to > _idleAt) _counters.busyUs += to - std::max(from, _idleAt);
+  _idleAt = std::max(_idleAt, to);
+}
+
+void Medium::finish(uint16_t node, bool delivered) {
+  Node& n = _nodes[node];
+  n.busy = false;
+  n.sent(n.dst, delivered);
+}
+
+bool Medium::received() {
+  if (_config.loss <= 0 || std::uniform_real_distribution<double>(0, 1)(_rng) >= _config.loss) return true;
+  ++_counters.lost;
+  return false;
+}
+
+bool Medium::broadcast(const uint8_t* mac) {
+  static constexpr uint8_t BROADCAST[6] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  return !memcmp(mac, BROADCAST, 6);
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+// One ESP-NOW channel shared by every node, in virtual us. Frames take their
+// 802.11b airtime at 1 Mbps, nodes sense the carrier and back off (DCF), two
+// starting within a slot of each other collide and neither is received.
+// Every reception (acks included) is also lost with a fixed probability.
+// Unicast frames are acked and retried by the MAC like the ESP radio does,
+// the sender learns the outcome through its Sent callback. Callbacks run
+// from advance(), at the virtual time the radio would raise them.
+class Medium {
+public:
+  static constexpr uint32_t SLOT_US = 20;
+  static constexpr uint32_t SIFS_US = 10;
+  static constexpr uint32_t DIFS_US = SIFS_US + 2 * SLOT_US;
+  static constexpr uint16_t CW_MIN = 31;
+  static constexpr uint16_t CW_MAX = 1023;
+
+  struct Config {
+    double loss = 0.0;   // per receiver and frame
+    uint8_t retries = 3; // MAC retransmits of an unacked unicast frame
+    uint32_t seed = 1;
+  };
+
+  using Receive = std::function<void(const uint8_t* src, const uint8_t* data, uint8_t len, int8_t rssi, bool broadcast)>;
+  using Sent = std::function<void(const uint8_t* dst, bool delivered)>;
+
+  struct Counters {
+    uint32_t frames = 0;     // data frames put on air, retransmits included
+    uint32_t collisions = 0; // of those, lost to an overlapping frame
+    uint32_t lost = 0;       // receptions dropped by the loss model
+    uint32_t failed = 0;     // unicast frames given up on after the retries
+    uint64_t busyUs = 0;     // time anything was on air, acks included
+  };
+
+  explicit Medium(const Config& config);
+
+  // Returns the node id used by send()
+  uint16_t attach(const uint8_t mac[6], int8_t rssi, Receive receive, Sent sent);
+
+  // False while the node still has a frame in flight
+  bool send(uint16_t node, const uint8_t dst[6], const uint8_t* data, uint8_t len);
+  bool busy(uint16_t node) const;
+
+  // Runs every event up to `until`, which becomes now()
+  void advance(uint64_t until);
+  uint64_t now() const { return _now; }
+
+  const Counters& counters() const { return _counters; }
+
+  // 192 us long preamble plus MAC header, vendor action frame and FCS
+  static uint32_t airtime(uint8_t len) { return 192 + 8 * (43 + len); }
+  static constexpr uint32_t ACK_US = 192 + 8 * 14;
+
+private:
+  enum EventType : uint8_t {
+    TRY_START, // backoff over, send unless the channel is busy
+    TX_END,
+    STATUS     // ack received or timed out
+  };
+
+  struct Event {
+    uint64_t at;
+    uint64_t order;
+    EventType type;
+    uint16_t node;
+    bool ok;
+
+    bool operator>(const Event& o) const {
+      return at != o.at ? at > o.at : order > o.order;
+    }
+  };
+
+  struct Node {
+    uint8_t mac[6];
+    int8_t rssi;
+    Receive receive;
+    Sent sent;
+
+    // Frame in flight
+    bool busy = false;
+    uint8_t dst[6];
+    uint8_t data[250];
+    uint8_t len = 0;
+    uint8_t attempts = 0;
+    uint16_t cw = CW_MIN;
+    uint64_t startedAt = 0;
+    bool collided = false;
+  };
+
+  Config _config;
+  std::vector<Node> _nodes;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+  std::vector<uint16_t> _onAir;
+  std::mt19937 _rng;
+  uint64_t _now = 0;
+  uint64_t _order = 0;
+  uint64_t _idleAt = 0; // end of the last frame or ack on air
+  Counters _counters;
+
+  void schedule(uint64_t at, EventType type, uint16_t node, bool ok = false);
+  void backoff(uint16_t node, uint64_t from);
+  void tryStart(uint16_t node);
+  void end(uint16_t node);
+  void occupy(uint64_t from, uint64_t to);
+  void finish(uint16_t node, bool delivered);
+  bool received();
+  static bool broadcast(const uint8_t* mac);
+};
@@ -0,0 +1,36 @@
+// QuickESPNow and WiFi for the gateway, backed by the Medium
+
+#include <ESP8266WiFi.h>
+#include <QuickESPNow.h>
+
+#include "Medium.h"
+
+ESP8266WiFiClass WiFi;
+QuickEspNow quickEspNow;
+
+bool QuickEspNow::begin(uint8_t, uint32_t, bool) {
+  if (!_medium) return false;
+
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+
+  auto receive = [this](const uint8_t* src, const uint8_t* data, uint8_t len, int8_t rssi, bool broadcast) {
+    if (_rcvd) _rcvd(const_cast<uint8_t*>(src), const_cast<uint8_t*>(data), len, rssi, broadcast);
+  };
+  auto sent = [this](const uint8_t* dst, bool delivered) {
+    if (_sent) _sent(const_cast<uint8_t*>(dst), delivered ? 0 : 1);
+  };
+  _node = _medium->attach(mac, 0, receive, sent);
+  return true;
+}
+
+comms_send_error_t QuickEspNow::send(const uint8_t* dstAddress, const uint8_t* payload, size_t payload_len) {
+  if (!_medium || !dstAddress) return COMMS_SEND_PARAM_ERROR;
+  if (payload_len > getMaxMessageLength()) return COMMS_SEND_PAYLOAD_LENGTH_ERROR;
+  if (!_medium->send(_node, dstAddress, payload, payload_len)) return COMMS_SEND_QUEUE_FULL_ERROR;
+  return COMMS_SEND_OK;
+}
+
+bool QuickEspNow::readyToSendData() {
+  return _medium && !_medium->busy(_node);
+}
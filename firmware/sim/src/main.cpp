@@ -0,0 +1,214 @@
+// ESP-NOW fleet simulator: the gateway firmware (main.cpp and everything it
+// uses) and N NowLink devices share one simulated channel in virtual time,
+// the host end of the serial link is modelled at the UART rate.
+//
+//   pio run -e native && .pio/build/native/program [--devices 10,50,100] [--seconds N]
+//       [--warmup N] [--rate EVENTS_PER_DEVICE_S] [--commands COMMANDS_S] [--loss P] [--baud N]
+//       [--batch BYTES] [--dedup MS] [--msgpack] [--seed N] [--csv]
+//
+// One row per fleet size, each run in a fresh process so the gateway starts
+// from boot. After a warmup (boot states and the rediscover burst) sensors
+// change at random and the host sends commands to switches and lights, both
+// as Poisson processes. Rows report delivery ratio and end to end latency of
+// those events (uplink: sensor change until the host has the state, downlink:
+// host command until the device's new state is back), how busy the UART
+// (gateway -> host) and the channel were, the longest a gateway write waited
+// for the UART and what the gateway dropped.
+
+#include <Arduino.h>
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <random>
+#include <vector>
+
+#include "Fleet.h"
+#include "Host.h"
+#include "Medium.h"
+#include <QuickESPNow.h>
+#include "telemetry/GatewayStats.h"
+
+// The gateway firmware
+void setup();
+void loop();
+
+namespace {
+  // Gateway loop() and UART granularity, devices loop every ms
+  constexpr uint64_t STEP_US = 100;
+  // Time given to the last events to land, they still count
+  constexpr uint64_t DRAIN_US = 2000000;
+
+  struct Options {
+    std::vector<unsigned> devices = {10, 50, 100, 200, 500};
+    unsigned seconds = 20;
+    unsigned warmup = 10; // long enough for the boot burst of 500 devices
+    double rate = 0.2;
+    double commands = 5;
+    double loss = 0.02;
+    uint32_t baud = 115200;
+    uint16_t batch = 256;
+    uint16_t dedup = 200;
+    bool msgpack = false;
+    uint32_t seed = 1;
+    bool csv = false;
+  } opts;
+
+  Medium* medium = nullptr;
+
+  uint64_t virtualMicros() {
+    return medium->now();
+  }
+
+  uint32_t stat(const Host& host, uint8_t counter) {
+    return counter < host.gatewayStats().size() ? host.gatewayStats()[counter] : 0;
+  }
+
+  void run(unsigned devices) {
+    Medium::Config mc;
+    mc.loss = opts.loss;
+    mc.seed = opts.seed;
+    Medium m(mc);
+    medium = &m;
+    setMicrosSource(virtualMicros);
+
+    Fleet::Config fc;
+    fc.devices = devices;
+    fc.msgpack = opts.msgpack;
+    fc.seed = opts.seed;
+    Fleet fleet(m, fc);
+
+    Host::Config hc;
+    hc.baud = opts.baud;
+    hc.batchBytes = opts.batch;
+    hc.dedupMs = opts.dedup;
+    Host host(m, fleet, hc);
+
+    Serial.captureTx(true);
+    quickEspNow.use(&m);
+    setup();
+    host.begin();
+
+    uint64_t startAt = opts.warmup * 1000000ull;
+    uint64_t stopAt = startAt + opts.seconds * 1000000ull;
+
+    std::mt19937 rng(opts.seed);
+    std::exponential_distribution<double> eventGap(opts.rate * devices / 1e6);
+    std::exponential_distribution<double> commandGap(opts.commands / 1e6);
+    double nextEvent = startAt + (opts.rate > 0 ? eventGap(rng) : 1e18);
+    double nextCommand = startAt + (opts.commands > 0 ? commandGap(rng) : 1e18);
+    Medium::Counters air0, air1;
+    Host::Counters line;
+    uint32_t drops0 = 0, dups0 = 0;
+
+    for (uint64_t t = 0; t <= stopAt + DRAIN_US; t += STEP_US) {
+      m.advance(t);
+
+      if (t == startAt) {
+        air0 = m.counters();
+        host.resetCounters();
+        drops0 = stat(host, GatewayStats::ESPNOW_RX_DROPS);
+        dups0 = stat(host, GatewayStats::ESPNOW_RX_DUPLICATES);
+      }
+      if (t == stopAt) {
+        air1 = m.counters();
+        line = host.counters();
+      }
+
+      for (; nextEvent <= t && t < stopAt; nextEvent += eventGap(rng)) fleet.event();
+      for (; nextCommand <= t && t < stopAt; nextCommand += commandGap(rng)) {
+        const uint8_t* mac;
+        uint8_t handle;
+        bool on;
+        if (fleet.command(mac, handle, on)) host.command(mac, handle, on);
+      }
+
+      if (t % 1000 == 0) fleet.loop();
+      if (!host.stalled()) loop();
+      host.update();
+    }
+
+    double span = opts.seconds * 1e6;
+    double serial = 100.0 * line.rxBusyUs / span;
+    double air = 100.0 * (air1.busyUs - air0.busyUs) / span;
+    uint32_t collisions = air1.collisions - air0.collisions;
+    uint32_t drops = stat(host, GatewayStats::ESPNOW_RX_DROPS) - drops0;
+    uint32_t dups = stat(host, GatewayStats::ESPNOW_RX_DUPLICATES) - dups0;
+
+    Delivery& up = fleet.uplink;
+    Delivery& down = fleet.downlink;
+    const char* fmt = opts.csv
+      ? "%u,%u,%.1f,%.1f,%.1f,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u,%u,%u\n"
+      : "%7u %7u %6.1f %7.1f %7.1f %6u %6.1f %7.1f %7.1f %7.1f %6.1f %7u %6u %6u %8u\n";
+    printf(fmt, devices,
+           up.generated, 100 * up.ratio(), up.percentile(0.5), up.percentile(0.99),
+           down.generated, 100 * down.ratio(), down.percentile(0.5), down.percentile(0.99),
+           serial, air, collisions, drops, dups, line.maxBacklogUs / 1000);
+  }
+
+  std::vector<unsigned> parseList(const char* s) {
+    std::vector<unsigned> out;
+    for (char* end; *s; s = *end ? end + 1 : end) {
+      unsigned n = strtoul(s, &end, 10);
+      if (end == s) break;
+      if (n) out.push_back(n);
+    }
+    return out;
+  }
+
+  void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+      if (!strcmp(argv[i], "--devices") && i + 1 < argc)       opts.devices = parseList(argv[++i]);
+      else if (!strcmp(argv[i], "--seconds") && i + 1 < argc)  opts.seconds = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--warmup") && i + 1 < argc)   opts.warmup = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--rate") && i + 1 < argc)     opts.rate = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--commands") && i + 1 < argc) opts.commands = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--loss") && i + 1 < argc)     opts.loss = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--baud") && i + 1 < argc)     opts.baud = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--batch") && i + 1 < argc)    opts.batch = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--dedup") && i + 1 < argc)    opts.dedup = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--seed") && i + 1 < argc)     opts.seed = strtoul(argv[++i], nullptr, 10);
+      else if (!strcmp(argv[i], "--msgpack"))                  opts.msgpack = true;
+      else if (!strcmp(argv[i], "--csv"))                      opts.csv = true;
+    }
+    if (!opts.seconds) opts.seconds = 1;
+    if (!opts.baud) opts.baud = 115200;
+  }
+}
+
+int main(int argc, char** argv) {
+  parseArgs(argc, argv);
+
+  if (opts.csv) {
+    printf("devices,events,up_delivered_pct,up_p50_ms,up_p99_ms,commands,down_delivered_pct,down_p50_ms,down_p99_ms,"
+           "serial_pct,air_pct,collisions,rx_drops,duplicates,max_backlog_ms\n");
+  } else {
+    printf("%7s %7s %6s %7s %7s %6s %6s %7s %7s %7s %6s %7s %6s %6s %8s\n", "devices", "events", "up%", "up p50",
+           "up p99", "cmds", "down%", "dn p50", "dn p99", "serial%", "air%", "collide", "drops", "dups", "backlog");
+  }
+
+  for (unsigned devices : opts.devices) {
+    fflush(stdout);
+
+    // The gateway keeps its state in globals, every size boots a new one
+    pid_t pid = fork();
+    if (pid == 0) {
+      run(devices);
+      fflush(stdout);
+      _exit(0);
+    }
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+      fprintf(stderr, "run with %u devices failed\n", devices);
+      return 1;
+    }
+  }
+  return 0;
+}
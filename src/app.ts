@@ -2,12 +2,22 @@ import { GatewayDevice } from "@/devices/gateway";
 import {
   devicemap,
   ensureEntityThen,
+  ensureHandleThen,
+  handleKey,
   pendingJobs,
   type EntityKey,
+  type PendingJob,
 } from "@/entities/helpers";
 import { extractFromTopic } from "@/entities/utils";
 import { env } from "@/env";
-import { ESPNOW_BROADCAST_MAC } from "@/helpers/espnow";
+import {
+  ESPNOW_BROADCAST_MAC,
+  encodeNowPayload,
+  expandNowBatch,
+  getNowHandle,
+  getRediscoverPayload,
+  withNowEntity,
+} from "@/helpers/espnow";
 import { getWizmoteButtonCode, getWizmotePayload } from "@/helpers/wizmote";
 import {
   getInterfaces,
@@ -106,7 +116,10 @@ export class App {
 
   /* ------------ SERIAL EVENT HANDLERS ------------------ */
 
-  private readonly handleSerialConnect = () => slog.info("Connected");
+  private readonly handleSerialConnect = () => {
+    slog.info("Connected");
+    this.requestRediscovery();
+  };
   private readonly handleSerialDisconnect = () => slog.warn("Disconnected");
 
   private readonly handleSerialError = (e: Error) => {
@@ -119,8 +132,21 @@ export class App {
 
   private readonly handleSerialPacket = (pkt: any) => {
     slog.debug("Received", pkt);
+    if (pkt.type === "GATEWAY_INIT") return this.requestRediscovery();
     if (pkt.type !== "ESPNOW_RX") return;
 
+    // --- Batched states ------------------------------------
+    if (pkt.payload?.[ENK.type] === NowPacketType.batch) {
+      for (const payload of expandNowBatch(pkt.payload)) {
+        this.processNowPacket({ ...pkt, payload });
+      }
+      return;
+    }
+
+    this.processNowPacket(pkt);
+  };
+
+  private processNowPacket(pkt: any): void {
     // --- Discovery packet ----------------------------------
     if (pkt.payload?.[ENK.type] === NowPacketType.discovery)
       return this.processDiscovery(pkt);
@@ -137,10 +163,10 @@ export class App {
       this.processDeviceData(pkt);
       return;
     }
-  };
+  }
 
   private processDiscovery(pkt: any): void {
-    type Dsc = { dev_id: string; p: string; id: string };
+    type Dsc = { dev_id: string; p: string; id: string; slp?: number };
     const p = pkt.payload as Dsc;
 
     // bootstrap / update device
@@ -149,6 +175,8 @@ export class App {
       device = createDevice(p.dev_id, pkt.mac);
       devicemap.set(p.dev_id, device);
     }
+    device.codec = pkt.codec;
+    device.sleepy = p[ENK.sleepy] === 1;
 
     device.discoverRSSI().then(() => device!.updateRSSI(pkt.rssi));
 
@@ -165,12 +193,18 @@ export class App {
 
     if (!entity) return;
 
+    const handle = getNowHandle(pkt.payload);
+    if (handle !== undefined) device.bindHandle(handle, entity);
+
     entity.discover();
 
-    // flush any queued jobs
-    const key: EntityKey = `${p.dev_id}/${p.id}`;
-    const jobs = pendingJobs.get(key);
-    if (jobs) {
+    // flush any queued jobs, asked for by id or by handle
+    const keys: EntityKey[] = [`${p.dev_id}/${p.id}`];
+    if (handle !== undefined) keys.push(handleKey(p.dev_id, handle));
+
+    for (const key of keys) {
+      const jobs = pendingJobs.get(key);
+      if (!jobs) continue;
       jobs.splice(0).forEach(job =>
         job({
           device,
@@ -185,17 +219,40 @@ export class App {
     type DevMsg = { dev_id: string; id: string };
     const { dev_id, id } = pkt.payload as DevMsg;
 
-    ensureEntityThen(dev_id, id, pkt.mac, ({ device, entity }) => {
+    const job: PendingJob = ({ device, entity }) => {
+      device.codec = pkt.codec;
       device.updateRSSI(pkt.rssi);
 
       if (isPacketProcessor(entity)) {
-        entity.processPacket(pkt);
+        entity.processPacket({
+          ...pkt,
+          payload: withNowEntity(pkt.payload, entity),
+        });
       }
-    });
+    };
+
+    // States name their entity by handle, older firmware by id
+    const handle = getNowHandle(pkt.payload);
+    if (handle !== undefined) {
+      ensureHandleThen(dev_id, handle, pkt.mac, job);
+    } else {
+      ensureEntityThen(dev_id, id, pkt.mac, job);
+    }
   }
 
   /* ------------ UTIL ------------------ */
 
+  // Devices pick a random point in the window, a restart is no reply storm
+  private requestRediscovery(): void {
+    if (!env.ESPNOW_REDISCOVER_WINDOW_MS) return;
+    serial.send("ESPNOW_TX", {
+      mac: ESPNOW_BROADCAST_MAC,
+      payload: encodeNowPayload(
+        getRediscoverPayload(env.ESPNOW_REDISCOVER_WINDOW_MS),
+      ),
+    });
+  }
+
   private bindMqttEvents(): void {
     mqtt.on("connected", this.handleMqttConnect);
     mqtt.on("disconnected", this.handleMqttDisconnect);
@@ -9,6 +9,7 @@ import {
   getEntityTopic,
   getUniqueId,
 } from "@/entities/utils";
+import { encodeNowPayload, NOW_CODEC, type NowCodec } from "@/helpers/espnow";
 import { getInterfaces } from "@/interfaces";
 import { rgb } from "@/utils/colors";
 import { debounce } from "@/utils/debounce";
@@ -19,6 +20,13 @@ const log = createLogger("DEVICE", rgb(174, 198, 207));
 
 export class EspNowDevice {
   readonly entities = new Map<string, Entity>();
+  readonly handles = new Map<number, Entity>();
+
+  // Follows whatever the device last sent, it understands both either way
+  codec: NowCodec = NOW_CODEC.json;
+
+  // Only listens right after it sent, downlink waits in the gateway mailbox
+  sleepy = false;
 
   constructor(
     public readonly id: string,
@@ -116,14 +124,28 @@ export class EspNowDevice {
     this.entities.set(entityId, entity);
   }
 
+  // Handles follow registration order on the device, a reflash may move them
+  bindHandle(handle: number, entity: Entity): void {
+    if (entity.handle !== undefined) this.handles.delete(entity.handle);
+    const previous = this.handles.get(handle);
+    if (previous) previous.handle = undefined;
+
+    entity.handle = handle;
+    this.handles.set(handle, entity);
+  }
+
+  send(payload: Record<string, unknown>): void {
+    serial.send(this.sleepy ? "ESPNOW_TX_MAILBOX" : "ESPNOW_TX", {
+      mac: this.mac,
+      payload: encodeNowPayload(payload, this.codec),
+    });
+  }
+
   requestEntityDiscovery(entityId: string): void {
-    const payload = Buffer.from(
-      JSON.stringify({
-        [ENK.type]: NowPacketType.discovery,
-        [ENK.id]: entityId,
-      }),
-    );
-    serial.send("ESPNOW_TX", { mac: this.mac, payload });
+    this.send({
+      [ENK.type]: NowPacketType.discovery,
+      [ENK.id]: entityId,
+    });
     log.debug("Requested discovery for", entityId, "on", this.id);
   }
 }
@@ -45,6 +45,11 @@ export class GatewayDevice {
       serial.on("disconnected", () => this.update(false));
       serial.on("packet", this.onSerialPacket);
 
+      mqtt.on("message", this.onMqttMessage);
+      void mqtt.subscribe(this.profileRequestTopic);
+      void mqtt.subscribe(this.peersRequestTopic);
+      void mqtt.subscribe(this.filterRequestTopic);
+
       this.interval = setInterval(
         () => this.update(),
         SERIAL_UPDATE_INTERVAL_MS,
@@ -59,6 +64,7 @@ export class GatewayDevice {
     serial.off("connected", () => that.update(true));
     serial.off("disconnected", () => that.update(false));
     serial.off("packet", that.onSerialPacket);
+    mqtt.off("message", that.onMqttMessage);
     clearInterval(that.interval);
   }
 
@@ -113,6 +119,37 @@ export class GatewayDevice {
     return `${SERIAL_ENTITY_TOPIC}/state`;
   }
 
+  get serialStatsTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/stats`;
+  }
+
+  /* Any payload dumps the gateway histograms, "clear" also resets them */
+  get profileRequestTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/profile/get`;
+  }
+
+  /* Any payload dumps the gateway peer table */
+  get peersRequestTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/peers/get`;
+  }
+
+  get peersTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/peers`;
+  }
+
+  /* Any payload dumps the RX filter hit counters */
+  get filterRequestTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/filter/get`;
+  }
+
+  get filterTopic() {
+    return `${SERIAL_ENTITY_TOPIC}/filter`;
+  }
+
+  profileTopic(probe: string | number) {
+    return `${SERIAL_ENTITY_TOPIC}/profile/${probe}`;
+  }
+
   private update(state: boolean = serial.isConnected): void {
     if (this.discoveryInFlight) {
       void this.discoveryInFlight.finally(() => this.update(state));
@@ -129,5 +166,39 @@ export class GatewayDevice {
     if (pkt.type === "GATEWAY_INIT") {
       this.discover(pkt.mac);
     }
+    if (pkt.type === "GATEWAY_STATS") {
+      const { type, ...stats } = pkt;
+      mqtt.publish(this.serialStatsTopic, JSON.stringify(stats));
+      log.debug("Gateway stats", stats);
+    }
+    if (pkt.type === "GATEWAY_PROFILE") {
+      const { probe, cpuMhz, samples, max, p50, p99, buckets } = pkt;
+      const us = (cycles: number) => +(cycles / cpuMhz).toFixed(1);
+      const profile = {
+        samples,
+        max_us: us(max),
+        p50_us: us(p50),
+        p99_us: us(p99),
+        buckets,
+      };
+      mqtt.publish(this.profileTopic(probe), JSON.stringify(profile));
+      log.debug("Gateway profile", probe, profile);
+    }
+    if (pkt.type === "GATEWAY_PEERS") {
+      mqtt.publish(this.peersTopic, JSON.stringify(pkt.peers));
+      log.debug("Gateway peers", pkt.peers.length);
+    }
+    if (pkt.type === "RX_FILTER_HITS") {
+      const { type, ...hits } = pkt;
+      mqtt.publish(this.filterTopic, JSON.stringify(hits));
+      log.debug("Gateway filter hits", hits);
+    }
+  };
+
+  private readonly onMqttMessage = (topic: string, payload: Buffer): void => {
+    if (topic === this.peersRequestTopic) return serial.requestPeers();
+    if (topic === this.filterRequestTopic) return serial.requestFilterHits();
+    if (topic !== this.profileRequestTopic) return;
+    serial.requestProfile(payload.toString().trim() === "clear");
   };
 }
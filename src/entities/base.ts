@@ -1,5 +1,6 @@
 import { titleCase } from "scule";
 
+import { nowEntityAddress } from "@/helpers/espnow";
 import { getInterfaces } from "@/interfaces";
 import { rgb } from "@/utils/colors";
 import { createLogger } from "@/utils/logger";
@@ -29,6 +30,9 @@ export abstract class EntityBase<TState extends object | string> {
   protected discoveryInFlight?: Promise<void>;
   protected queuedState?: TState;
 
+  // Announced by the device in discovery, commands go by id until then
+  handle?: number;
+
   protected logger = entityLogger;
 
   constructor(
@@ -36,6 +40,10 @@ export abstract class EntityBase<TState extends object | string> {
     public readonly device: EspNowDevice,
   ) {}
 
+  protected get nowAddress() {
+    return nowEntityAddress(this.id, this.handle);
+  }
+
   protected get supportsCommand(): boolean {
     return COMMAND_CAPABLE_PLATFORMS.includes(this.platform);
   }
@@ -1,3 +1,4 @@
+import { encodeNowPayload, type NowAddress } from "@/helpers/espnow";
 import { getInterfaces } from "@/interfaces";
 
 import type { EspNowDevice } from "../devices/espnow";
@@ -14,7 +15,7 @@ export type PendingJob = ({
   device: EspNowDevice;
   entity: Entity;
 }) => void; // what to do after discovery
-export type EntityKey = `${string}/${string}`; //  dev_id/entity_id  (cheap tuple)
+export type EntityKey = `${string}/${string}`; //  dev_id/entity_id, dev_id/#n
 
 export const devicemap = new Map<string, EspNowDevice>();
 export const pendingJobs = new Map<EntityKey, PendingJob[]>();
@@ -35,24 +36,54 @@ export function ensureEntityThen(
     return;
   }
 
+  queueDiscovery(key, mac, { [ENK.id]: entityId }, device, job);
+}
+
+export function handleKey(devId: string, handle: number): EntityKey {
+  return `${devId}/#${handle}`;
+}
+
+/* Same as ensureEntityThen for traffic that names the entity by handle */
+export function ensureHandleThen(
+  devId: string,
+  handle: number,
+  mac: string,
+  job: PendingJob,
+) {
+  const device = devicemap.get(devId);
+  const entity = device?.handles.get(handle);
+  if (device && entity) {
+    job({ device, entity });
+    return;
+  }
+
+  const key = handleKey(devId, handle);
+  queueDiscovery(key, mac, { [ENK.handle]: handle }, device, job);
+}
+
+function queueDiscovery(
+  key: EntityKey,
+  mac: string,
+  address: NowAddress,
+  device: EspNowDevice | undefined,
+  job: PendingJob,
+) {
   /* ---------- queue the job ---------- */
   (pendingJobs.get(key) ?? pendingJobs.set(key, []).get(key)!).push(job);
 
   /* ---------- fire a single discovery request ---------- */
-  if (!pendingReq.has(key)) {
-    pendingReq.add(key);
-
-    log.debug("Requesting auto discovery for", entityId, "on", mac);
-    const payloadStr = JSON.stringify({
-      [ENK.type]: NowPacketType.discovery,
-      [ENK.id]: entityId,
-    });
-    serial.send("ESPNOW_TX", {
-      mac,
-      payload: Buffer.from(payloadStr),
-    });
-
-    // clear the debounce flag after 3 s so we can re-ask if node is down
-    setTimeout(() => pendingReq.delete(key), 3000);
+  if (pendingReq.has(key)) return;
+  pendingReq.add(key);
+
+  log.debug("Requesting auto discovery for", key, "on", mac);
+  // Unknown devices are asked in JSON, NowLink reads either codec
+  const payload = { [ENK.type]: NowPacketType.discovery, ...address };
+  if (device) {
+    device.send(payload);
+  } else {
+    serial.send("ESPNOW_TX", { mac, payload: encodeNowPayload(payload) });
   }
+
+  // clear the debounce flag after 3 s so we can re-ask if node is down
+  setTimeout(() => pendingReq.delete(key), 3000);
 }
@@ -41,10 +41,15 @@ export const ENK = {
   state: "stat",
   type: ".t",
   brightness: "br",
+  states: "e",
+  handle: "n",
+  window: "w",
+  sleepy: "slp",
 } as const;
 
 export const NowPacketType = {
   discovery: "d",
   state: "s",
   hybrid: "h",
+  batch: "b",
 } as const;
@@ -1,6 +1,6 @@
 import { z } from "zod/v4";
 
-import { getInterfaces } from "@/interfaces";
+import type { NowAddress } from "@/helpers/espnow";
 import type { DecodedPacket } from "@/interfaces/protocols/serial";
 
 import type { EspNowDevice } from "../../devices/espnow";
@@ -9,8 +9,6 @@ import type { CommandProcessor, PacketProcessor } from "../capabilities";
 import { ENK, HAK } from "../keyvals";
 import { PLATFORM } from "../platforms";
 
-const { serial } = getInterfaces();
-
 const LightPayloadSchema = z.object({
   [ENK.platform]: z.literal(PLATFORM.LIGHT),
   [ENK.id]: z.string(),
@@ -65,8 +63,8 @@ export class LightEntity
   processMessage(topic: string, payload: Buffer): void {
     if (topic !== this.commandTopic) return;
 
-    const json: Partial<LightPayload> = {
-      [ENK.id]: this.id,
+    const json: Partial<LightPayload> & NowAddress = {
+      ...this.nowAddress,
     };
     try {
       const receivedPayload = JSON.parse(payload.toString());
@@ -81,10 +79,7 @@ export class LightEntity
       json[ENK.state] = payload.toString() === "ON" ? "ON" : "OFF";
     }
 
-    serial.send("ESPNOW_TX", {
-      mac: this.device.mac,
-      payload: Buffer.from(JSON.stringify(json)),
-    });
+    this.device.send(json);
   }
 
   processPacket(packet: DecodedPacket): void {
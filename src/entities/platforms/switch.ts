@@ -1,6 +1,5 @@
 import { z } from "zod/v4";
 
-import { getInterfaces } from "@/interfaces";
 import type { DecodedPacket } from "@/interfaces/protocols/serial";
 
 import type { EspNowDevice } from "../../devices/espnow";
@@ -9,8 +8,6 @@ import type { CommandProcessor, PacketProcessor } from "../capabilities";
 import { ENK } from "../keyvals";
 import { PLATFORM } from "../platforms";
 
-const { serial } = getInterfaces();
-
 const SwitchPayloadSchema = z.object({
   [ENK.platform]: z.literal(PLATFORM.SWITCH),
   [ENK.id]: z.string(),
@@ -38,15 +35,12 @@ export class SwitchEntity
     const desiredState: SwitchState =
       payload.toString() === "ON" ? "ON" : "OFF";
 
-    const json: Omit<SwitchPayload, "p" | "dev_id"> = {
-      [ENK.id]: this.id,
+    const json = {
+      ...this.nowAddress,
       [ENK.state]: desiredState,
     };
 
-    serial.send("ESPNOW_TX", {
-      mac: this.device.mac,
-      payload: Buffer.from(JSON.stringify(json)),
-    });
+    this.device.send(json);
   }
 
   processPacket(packet: DecodedPacket): void {
@@ -1,5 +1,11 @@
 import { prettifyError, z } from "zod/v4";
 
+// Comma separated list, blanks dropped
+const csv = z
+  .string()
+  .default("")
+  .transform(s => s.split(",").map(v => v.trim()).filter(Boolean));
+
 const ENV_SCHEMA = z.object({
   NODE_ENV: z.enum(["development", "production"]).default("development"),
   DEBUG: z.coerce.boolean().default(false),
@@ -14,8 +20,50 @@ const ENV_SCHEMA = z.object({
 
   // SERIAL
   SERIAL_PORT: z.string(),
-  SERIAL_BAUD_RATE: z.coerce.number().default(9600),
+  SERIAL_BAUD_RATE: z.coerce.number().default(9600), // gateway boot rate
+  // negotiated with the gateway after connect, unset keeps SERIAL_BAUD_RATE
+  SERIAL_TARGET_BAUD_RATE: z.coerce.number().max(921600).optional(),
+  // set to 1 for gateways flashed before SERIAL_V2
+  SERIAL_PROTOCOL_VERSION: z.coerce
+    .number()
+    .pipe(z.union([z.literal(1), z.literal(2)]))
+    .default(2),
   SERIAL_RESET_ON_CONNECT: z.coerce.boolean().default(false),
+  // 0 disables batching of received ESPNOW frames on the gateway
+  SERIAL_RX_BATCH_MAX_BYTES: z.coerce.number().min(0).max(512).default(256),
+  SERIAL_RX_BATCH_MAX_AGE_MS: z.coerce.number().min(0).max(65535).default(20),
+  // repeats of a sender's last frame within this window are dropped by the
+  // gateway, 0 forwards everything
+  SERIAL_RX_DEDUP_WINDOW_MS: z.coerce.number().min(0).max(65535).default(200),
+  // received frames the gateway drops before they reach serial: weaker than
+  // the RSSI, from a denied MAC, or when any allow list is set, matching none
+  // of them (sender MAC, or payload prefix in hex: "7b,c1" is NowLink JSON
+  // and MessagePack)
+  SERIAL_RX_MIN_RSSI: z.coerce.number().min(-128).max(0).default(-128),
+  SERIAL_RX_DENY_MACS: csv,
+  SERIAL_RX_ALLOW_MACS: csv,
+  SERIAL_RX_ALLOW_PREFIXES: csv.pipe(
+    z.array(z.string().regex(/^([0-9a-f]{2}){1,8}$/i)),
+  ),
+  // GATEWAY_STATS report interval, 0 disables
+  SERIAL_STATS_INTERVAL_S: z.coerce.number().min(0).max(65535).default(60),
+  // failed ESPNOW sends are retried by the gateway, 1 disables retries
+  SERIAL_TX_RETRY_ATTEMPTS: z.coerce.number().min(1).max(255).default(3),
+  SERIAL_TX_RETRY_BACKOFF_MS: z.coerce.number().min(0).max(65535).default(5),
+  SERIAL_TX_RETRY_MAX_BACKOFF_MS: z.coerce
+    .number()
+    .min(0)
+    .max(65535)
+    .default(100),
+
+  // ESPNOW
+  // devices spread their discovery replies over this window when the gateway
+  // comes up, 0 disables the broadcast rediscover request
+  ESPNOW_REDISCOVER_WINDOW_MS: z.coerce
+    .number()
+    .min(0)
+    .max(65535)
+    .default(3000),
 });
 
 const { data, error } = ENV_SCHEMA.safeParse(process.env);
@@ -1 +1,91 @@
+import { ENK, NowPacketType } from "@/entities/keyvals";
+import { decodeMsgPack, encodeMsgPack } from "@/utils/msgpack";
+
 export const ESPNOW_BROADCAST_MAC = "ff:ff:ff:ff:ff:ff";
+
+/* NowLink payload codecs, devices pick one and accept both */
+export const NOW_CODEC = {
+  json: "json",
+  msgpack: "msgpack",
+} as const;
+export type NowCodec = (typeof NOW_CODEC)[keyof typeof NOW_CODEC];
+
+// Never valid as the first byte of JSON or MessagePack
+export const NOW_MSGPACK_MARKER = 0xc1;
+
+export function decodeNowPayload(buf: Buffer): {
+  payload: Record<string, unknown>;
+  codec: NowCodec;
+} {
+  if (buf[0] === NOW_MSGPACK_MARKER) {
+    const payload = decodeMsgPack(buf.subarray(1));
+    if (typeof payload !== "object" || payload === null) {
+      throw new Error("NowLink msgpack payload is not a map");
+    }
+    return {
+      payload: payload as Record<string, unknown>,
+      codec: NOW_CODEC.msgpack,
+    };
+  }
+  return { payload: JSON.parse(buf.toString()), codec: NOW_CODEC.json };
+}
+
+export function encodeNowPayload(
+  payload: Record<string, unknown>,
+  codec: NowCodec = NOW_CODEC.json,
+): Buffer {
+  if (codec === NOW_CODEC.msgpack) {
+    return Buffer.concat([
+      Buffer.from([NOW_MSGPACK_MARKER]),
+      encodeMsgPack(payload),
+    ]);
+  }
+  return Buffer.from(JSON.stringify(payload));
+}
+
+/* A batch carries dev_id once, each state comes out as its own state payload */
+export function expandNowBatch(
+  payload: Record<string, unknown>,
+): Record<string, unknown>[] {
+  const states = payload[ENK.states];
+  if (!Array.isArray(states)) return [];
+  return states.map(state => ({
+    [ENK.type]: NowPacketType.state,
+    [ENK.device_id]: payload[ENK.device_id],
+    ...state,
+  }));
+}
+
+/* Broadcast, every device announces all its entities spread over the window */
+export function getRediscoverPayload(windowMs: number) {
+  return {
+    [ENK.type]: NowPacketType.discovery,
+    [ENK.window]: windowMs,
+  };
+}
+
+/* Entities announce a numeric handle in discovery, later traffic uses it */
+export type NowAddress = { [ENK.id]: string } | { [ENK.handle]: number };
+
+export function getNowHandle(
+  payload: Record<string, unknown>,
+): number | undefined {
+  const handle = payload[ENK.handle];
+  return Number.isInteger(handle) ? (handle as number) : undefined;
+}
+
+export function nowEntityAddress(id: string, handle?: number): NowAddress {
+  return handle === undefined ? { [ENK.id]: id } : { [ENK.handle]: handle };
+}
+
+/* Handle addressed states get the id and platform discovery told us */
+export function withNowEntity(
+  payload: Record<string, unknown>,
+  entity: { id: string; platform: string },
+): Record<string, unknown> {
+  return {
+    ...payload,
+    [ENK.platform]: entity.platform,
+    [ENK.id]: entity.id,
+  };
+}
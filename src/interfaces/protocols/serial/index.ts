@@ -3,3 +3,7 @@ export * from "./v1/decoder";
 export * from "./v1/encoder";
 export * from "./v1/packets";
 export * from "./v1/utils";
+export * from "./v2/constants";
+export * from "./v2/decoder";
+export * from "./v2/frame";
+export * from "./v2/utils";
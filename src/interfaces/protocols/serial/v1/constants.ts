@@ -8,6 +8,12 @@ export const SIZE = {
   MAC: 6,
   RSSI: 1,
   LEN: 1,
+  COUNT: 1,
+  SEQ: 1,
+  FREE: 1,
+  BAUD: 4,
+  U32: 4,
+  STATUS: 1,
   CRC: 1,
 } as const;
 
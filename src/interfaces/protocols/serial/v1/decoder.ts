@@ -1,5 +1,6 @@
 import EventEmitter from "events";
 
+import { decodeNowPayload, type NowCodec } from "@/helpers/espnow";
 import { MAC } from "@/utils/mac";
 
 import {
@@ -8,33 +9,110 @@ import {
   SIZE,
   SYNC_BYTE,
 } from "./constants";
-import { PACKET_BYTE, RX_PACKET } from "./packets";
+import {
+  PACKET_BYTE,
+  PROFILE_PROBES,
+  RX_PACKET,
+  STATS_COUNTERS,
+  type ProfileProbe,
+  type StatsCounter,
+} from "./packets";
 import { crc8, toInt8 } from "./utils";
 
 const MODULE_TAG = "[DECODER]";
 
+// PROBE + CPU_MHZ + SAMPLES + MAX + P50 + P99, COUNT follows
+const PROFILE_HEADER_SIZE = 1 + 1 + 4 * SIZE.U32;
+
+// MAC + AGE_MS + RSSI + FRAMES + DUPLICATES
+const PEER_RECORD_SIZE = SIZE.MAC + SIZE.U32 + SIZE.RSSI + 2 * SIZE.U32;
+
+const RX_PACKET_BYTES = Object.values(RX_PACKET).map(
+  p => PACKET_BYTE[p],
+) as number[];
+
 export interface GatewayInitPacket {
   type: typeof RX_PACKET.GATEWAY_INIT;
   mac: string;
 }
 
+export interface SerialBaudAckPacket {
+  type: typeof RX_PACKET.SERIAL_BAUD_ACK;
+  baud: number;
+  status: number;
+}
+
+export interface GatewayStatsPacket {
+  type: typeof RX_PACKET.GATEWAY_STATS;
+  uptimeMs: number;
+  freeHeap: number;
+  counters: Partial<Record<StatsCounter, number>>;
+}
+
+/* Durations in CPU cycles, bucket i counts [2^(i-1), 2^i) */
+export interface GatewayProfilePacket {
+  type: typeof RX_PACKET.GATEWAY_PROFILE;
+  probe: ProfileProbe | number; // numeric when this host does not know it
+  cpuMhz: number;
+  samples: number;
+  max: number;
+  p50: number;
+  p99: number;
+  buckets: number[];
+}
+
+export interface GatewayPeer {
+  mac: string;
+  ageMs: number; // since its last frame
+  rssi: number; // moving average
+  frames: number;
+  duplicates: number;
+}
+
+export interface GatewayPeersPacket {
+  type: typeof RX_PACKET.GATEWAY_PEERS;
+  peers: GatewayPeer[];
+}
+
+/* Frames each part of the RX_FILTER table decided since it was set */
+export interface RxFilterHitsPacket {
+  type: typeof RX_PACKET.RX_FILTER_HITS;
+  rssiHits: number;
+  defaultHits: number;
+  hits: number[]; // per rule
+}
+
 export interface EspNowRxPacket {
   type: typeof RX_PACKET.ESPNOW_RX;
   mac: string;
   rssi: number;
   payload: Record<string, unknown>;
+  codec: NowCodec;
 }
 
 export interface EspNowTxStatusPacket {
   type: typeof RX_PACKET.ESPNOW_TX_STATUS;
   mac: string;
+  seq: number;
   status: number;
 }
 
+export interface EspNowTxCreditsPacket {
+  type: typeof RX_PACKET.ESPNOW_TX_CREDITS;
+  free: number;
+  seq: number;
+}
+
 export type DecodedPacket =
   | GatewayInitPacket
+  | SerialBaudAckPacket
+  | GatewayStatsPacket
+  | GatewayProfilePacket
+  | GatewayPeersPacket
+  | RxFilterHitsPacket
   | EspNowRxPacket
-  | EspNowTxStatusPacket;
+  | EspNowTxStatusPacket
+  | EspNowTxCreditsPacket;
 
 type PacketDecoderEvents = {
   packet: [DecodedPacket];
@@ -64,7 +142,7 @@ export class PacketDecoder extends EventEmitter<PacketDecoderEvents> {
       }
 
       const typeByte = this.buffer[2]!;
-      if (!(Object.values(PACKET_BYTE) as number[]).includes(typeByte)) {
+      if (!RX_PACKET_BYTES.includes(typeByte)) {
         this.buffer = this.buffer.subarray(1);
         continue;
       }
@@ -81,9 +159,19 @@ export class PacketDecoder extends EventEmitter<PacketDecoderEvents> {
         continue;
       }
 
+      // Consumed before decoding so a body that fails to decode is not
+      // retried on every later feed
       const body = frame.subarray(FIXED_HEADER_SIZE, frameLen - 1);
-      this.emit("packet", this.parse(typeByte, body));
       this.buffer = this.buffer.subarray(frameLen);
+
+      let packets: DecodedPacket[];
+      try {
+        packets = PacketDecoder.decodeBody(typeByte, body);
+      } catch (err) {
+        console.warn(MODULE_TAG, "Dropping malformed frame", err);
+        continue;
+      }
+      packets.forEach(p => this.emit("packet", p));
     }
 
     if (iterations >= MAX_ITERATIONS) {
@@ -98,6 +186,36 @@ export class PacketDecoder extends EventEmitter<PacketDecoderEvents> {
     switch (typeByte) {
       case PACKET_BYTE[RX_PACKET.GATEWAY_INIT]:
         return FIXED_HEADER_SIZE + SIZE.MAC + SIZE.CRC;
+      case PACKET_BYTE[RX_PACKET.SERIAL_BAUD_ACK]:
+        return FIXED_HEADER_SIZE + SIZE.BAUD + SIZE.STATUS + SIZE.CRC;
+      case PACKET_BYTE[RX_PACKET.GATEWAY_STATS]: {
+        const countAt = FIXED_HEADER_SIZE + SIZE.U32 + SIZE.U32;
+        if (this.buffer.length <= countAt) return null;
+        return (
+          countAt + SIZE.COUNT + this.buffer[countAt]! * SIZE.U32 + SIZE.CRC
+        );
+      }
+      case PACKET_BYTE[RX_PACKET.GATEWAY_PROFILE]: {
+        const countAt = FIXED_HEADER_SIZE + PROFILE_HEADER_SIZE;
+        if (this.buffer.length <= countAt) return null;
+        return (
+          countAt + SIZE.COUNT + this.buffer[countAt]! * SIZE.U32 + SIZE.CRC
+        );
+      }
+      case PACKET_BYTE[RX_PACKET.GATEWAY_PEERS]: {
+        if (this.buffer.length <= FIXED_HEADER_SIZE) return null;
+        const count = this.buffer[FIXED_HEADER_SIZE]!;
+        return (
+          FIXED_HEADER_SIZE + SIZE.COUNT + count * PEER_RECORD_SIZE + SIZE.CRC
+        );
+      }
+      case PACKET_BYTE[RX_PACKET.RX_FILTER_HITS]: {
+        const countAt = FIXED_HEADER_SIZE + SIZE.U32 + SIZE.U32;
+        if (this.buffer.length <= countAt) return null;
+        return (
+          countAt + SIZE.COUNT + this.buffer[countAt]! * SIZE.U32 + SIZE.CRC
+        );
+      }
       case PACKET_BYTE[RX_PACKET.ESPNOW_RX]: {
         if (
           this.buffer.length <
@@ -117,42 +235,184 @@ export class PacketDecoder extends EventEmitter<PacketDecoderEvents> {
       }
       case PACKET_BYTE[RX_PACKET.ESPNOW_TX_STATUS]:
         const STATUS_SIZE = 1;
-        return FIXED_HEADER_SIZE + SIZE.MAC + STATUS_SIZE + SIZE.CRC;
+        return (
+          FIXED_HEADER_SIZE + SIZE.MAC + SIZE.SEQ + STATUS_SIZE + SIZE.CRC
+        );
+      case PACKET_BYTE[RX_PACKET.ESPNOW_TX_CREDITS]:
+        return FIXED_HEADER_SIZE + SIZE.FREE + SIZE.SEQ + SIZE.CRC;
+      case PACKET_BYTE[RX_PACKET.ESPNOW_RX_BATCH]: {
+        // Records carry their own LEN, walk them to find the end of the frame
+        if (this.buffer.length < FIXED_HEADER_SIZE + SIZE.COUNT) return null;
+        const count = this.buffer[FIXED_HEADER_SIZE]!;
+        let offset = FIXED_HEADER_SIZE + SIZE.COUNT;
+        for (let i = 0; i < count; i++) {
+          const lenAt = offset + SIZE.MAC + SIZE.RSSI;
+          if (this.buffer.length <= lenAt) return null;
+          offset = lenAt + SIZE.LEN + this.buffer[lenAt]!;
+        }
+        return offset + SIZE.CRC;
+      }
       default:
         return null;
     }
   }
 
-  private parse(typeByte: number, body: Buffer): DecodedPacket {
+  /* TDATA of one frame, shared with the V2 decoder */
+  static decodeBody(typeByte: number, body: Buffer): DecodedPacket[] {
+    if (typeByte === PACKET_BYTE[RX_PACKET.ESPNOW_RX_BATCH]) {
+      return this.parseBatch(body);
+    }
+    if (typeByte === PACKET_BYTE[RX_PACKET.ESPNOW_RX]) {
+      const { packet } = this.parseRxRecord(body, 0);
+      return packet ? [packet] : [];
+    }
+    return [this.parse(typeByte, body)];
+  }
+
+  private static parse(typeByte: number, body: Buffer): DecodedPacket {
     switch (typeByte) {
       case PACKET_BYTE[RX_PACKET.GATEWAY_INIT]:
         return {
           type: RX_PACKET.GATEWAY_INIT,
           mac: MAC.fromBuf(body.subarray(0, SIZE.MAC)),
         };
-      case PACKET_BYTE[RX_PACKET.ESPNOW_RX]: {
-        const mac = MAC.fromBuf(body.subarray(0, SIZE.MAC));
-        const rssi = toInt8(body[SIZE.MAC]!);
-        const payloadLen = body[SIZE.MAC + SIZE.RSSI]!;
-        const payloadBuf = body.subarray(
-          SIZE.MAC + SIZE.RSSI + SIZE.LEN,
-          SIZE.MAC + SIZE.RSSI + SIZE.LEN + payloadLen,
-        );
+      case PACKET_BYTE[RX_PACKET.SERIAL_BAUD_ACK]:
         return {
-          type: RX_PACKET.ESPNOW_RX,
-          mac,
-          rssi,
-          payload: JSON.parse(payloadBuf.toString()),
+          type: RX_PACKET.SERIAL_BAUD_ACK,
+          baud: body.readUInt32LE(0),
+          status: body[SIZE.BAUD]!,
+        };
+      case PACKET_BYTE[RX_PACKET.GATEWAY_STATS]:
+        return this.parseStats(body);
+      case PACKET_BYTE[RX_PACKET.GATEWAY_PROFILE]:
+        return this.parseProfile(body);
+      case PACKET_BYTE[RX_PACKET.GATEWAY_PEERS]:
+        return this.parsePeers(body);
+      case PACKET_BYTE[RX_PACKET.RX_FILTER_HITS]: {
+        const count = body[SIZE.U32 + SIZE.U32]!;
+        return {
+          type: RX_PACKET.RX_FILTER_HITS,
+          rssiHits: body.readUInt32LE(0),
+          defaultHits: body.readUInt32LE(SIZE.U32),
+          hits: Array.from({ length: count }, (_, i) =>
+            body.readUInt32LE(SIZE.U32 + SIZE.U32 + SIZE.COUNT + i * SIZE.U32),
+          ),
         };
       }
       case PACKET_BYTE[RX_PACKET.ESPNOW_TX_STATUS]:
         return {
           type: RX_PACKET.ESPNOW_TX_STATUS,
           mac: MAC.fromBuf(body.subarray(0, SIZE.MAC)),
-          status: body[SIZE.MAC]!,
+          seq: body[SIZE.MAC]!,
+          status: body[SIZE.MAC + SIZE.SEQ]!,
+        };
+      case PACKET_BYTE[RX_PACKET.ESPNOW_TX_CREDITS]:
+        return {
+          type: RX_PACKET.ESPNOW_TX_CREDITS,
+          free: body[0]!,
+          seq: body[SIZE.FREE]!,
         };
       default:
         throw new Error(`Unhandled packet type ${typeByte}`);
     }
   }
+
+  /* Counters this host does not know yet are skipped */
+  private static parseStats(body: Buffer): GatewayStatsPacket {
+    const count = body[SIZE.U32 + SIZE.U32]!;
+    const counters: GatewayStatsPacket["counters"] = {};
+    STATS_COUNTERS.slice(0, count).forEach((name, i) => {
+      counters[name] = body.readUInt32LE(
+        SIZE.U32 + SIZE.U32 + SIZE.COUNT + i * SIZE.U32,
+      );
+    });
+    return {
+      type: RX_PACKET.GATEWAY_STATS,
+      uptimeMs: body.readUInt32LE(0),
+      freeHeap: body.readUInt32LE(SIZE.U32),
+      counters,
+    };
+  }
+
+  /* <PROBE><CPU_MHZ><SAMPLES><MAX><P50><P99><COUNT><BUCKETS...> */
+  private static parseProfile(body: Buffer): GatewayProfilePacket {
+    const probe = body[0]!;
+    const u32 = (i: number) => body.readUInt32LE(2 + i * SIZE.U32);
+    const count = body[PROFILE_HEADER_SIZE]!;
+    const buckets = Array.from({ length: count }, (_, i) =>
+      body.readUInt32LE(PROFILE_HEADER_SIZE + SIZE.COUNT + i * SIZE.U32),
+    );
+    return {
+      type: RX_PACKET.GATEWAY_PROFILE,
+      probe: PROFILE_PROBES[probe] ?? probe,
+      cpuMhz: body[1]!,
+      samples: u32(0),
+      max: u32(1),
+      p50: u32(2),
+      p99: u32(3),
+      buckets,
+    };
+  }
+
+  /* <COUNT> then <MAC><AGE_MS><RSSI><FRAMES><DUPLICATES> per peer */
+  private static parsePeers(body: Buffer): GatewayPeersPacket {
+    const peers = Array.from({ length: body[0]! }, (_, i) => {
+      const at = SIZE.COUNT + i * PEER_RECORD_SIZE;
+      const u32At = at + SIZE.MAC;
+      return {
+        mac: MAC.fromBuf(body.subarray(at, at + SIZE.MAC)),
+        ageMs: body.readUInt32LE(u32At),
+        rssi: toInt8(body[u32At + SIZE.U32]!),
+        frames: body.readUInt32LE(u32At + SIZE.U32 + SIZE.RSSI),
+        duplicates: body.readUInt32LE(u32At + 2 * SIZE.U32 + SIZE.RSSI),
+      };
+    });
+    return { type: RX_PACKET.GATEWAY_PEERS, peers };
+  }
+
+  /* <MAC(6B)><RSSI(1B)><LEN(1B)><PAYLOAD(LEN)> at offset, packet is null
+     when the payload is not NowLink (WizMote, foreign ESP-NOW traffic) */
+  private static parseRxRecord(
+    body: Buffer,
+    offset: number,
+  ): { packet: EspNowRxPacket | null; next: number } {
+    const mac = MAC.fromBuf(body.subarray(offset, offset + SIZE.MAC));
+    const rssi = toInt8(body[offset + SIZE.MAC]!);
+    const payloadLen = body[offset + SIZE.MAC + SIZE.RSSI]!;
+    const payloadStart = offset + SIZE.MAC + SIZE.RSSI + SIZE.LEN;
+    const payloadBuf = body.subarray(payloadStart, payloadStart + payloadLen);
+    const next = payloadStart + payloadLen;
+    try {
+      return {
+        packet: {
+          type: RX_PACKET.ESPNOW_RX,
+          mac,
+          rssi,
+          ...decodeNowPayload(payloadBuf),
+        },
+        next,
+      };
+    } catch (err) {
+      console.warn(
+        MODULE_TAG,
+        `Skipping undecodable payload from ${mac}`,
+        err,
+      );
+      return { packet: null, next };
+    }
+  }
+
+  /* ESPNOW_RX_BATCH is surfaced as the ESPNOW_RX packets it carries, a
+     record that does not decode costs only itself */
+  private static parseBatch(body: Buffer): EspNowRxPacket[] {
+    const count = body[0]!;
+    const packets: EspNowRxPacket[] = [];
+    let offset = SIZE.COUNT;
+    for (let i = 0; i < count; i++) {
+      const { packet, next } = this.parseRxRecord(body, offset);
+      if (packet) packets.push(packet);
+      offset = next;
+    }
+    return packets;
+  }
 }
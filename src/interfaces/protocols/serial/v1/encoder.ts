@@ -1,14 +1,45 @@
 import { MAC } from "@/utils/mac";
 
+import { PROTOCOL_VERSION_V2 } from "../v2/constants";
+import { frameV2 } from "../v2/frame";
 import { PROTOCOL_VERSION, SYNC_BYTE } from "./constants";
-import { PACKET_BYTE, TX_PACKET } from "./packets";
+import {
+  PACKET_BYTE,
+  RX_FILTER_MAX_PREFIX,
+  RX_FILTER_MAX_RULES,
+  TX_PACKET,
+  type ConfigKey,
+  type RxFilterAction,
+} from "./packets";
 import { crc8 } from "./utils";
 
+/* First match decides, a rule without mac or prefix matches every frame */
+export type RxFilterRule = {
+  action: RxFilterAction;
+  mac?: string;
+  prefix?: Buffer;
+};
+
 type PacketTypeDataMap = {
+  [TX_PACKET.GATEWAY_CONFIG]: {
+    key: ConfigKey;
+    value: Buffer;
+  };
+  [TX_PACKET.SERIAL_BAUD]: {
+    baud: number;
+  };
+  [TX_PACKET.RX_FILTER]: {
+    defaultAction: RxFilterAction;
+    minRssi: number;
+    rules: RxFilterRule[];
+  };
   [TX_PACKET.ESPNOW_TX]: {
     mac: string;
     payload: Buffer;
+    seq?: number; // set by the serial interface, echoed in ESPNOW_TX_STATUS
   };
+  // Held by the gateway until the (sleepy) peer is heard
+  [TX_PACKET.ESPNOW_TX_MAILBOX]: PacketTypeDataMap[typeof TX_PACKET.ESPNOW_TX];
   RAW: {
     type: number;
     payload: Buffer;
@@ -18,8 +49,18 @@ type PacketTypeDataMap = {
 export type HandledPacketType = keyof PacketTypeDataMap;
 export type PacketData<T extends HandledPacketType> = PacketTypeDataMap[T];
 
+export type ProtocolVersion =
+  | typeof PROTOCOL_VERSION
+  | typeof PROTOCOL_VERSION_V2;
+
 export class PacketEncoder {
-  private static wrap(type: number, body: Buffer): Buffer {
+  private static wrap(
+    type: number,
+    body: Buffer,
+    version: ProtocolVersion,
+  ): Buffer {
+    if (version === PROTOCOL_VERSION_V2) return frameV2(type, body);
+
     const header = Buffer.from([SYNC_BYTE, PROTOCOL_VERSION, type]);
     const withoutSync = Buffer.concat([header.subarray(1), body]);
     const crc = Buffer.from([crc8(withoutSync)]);
@@ -29,25 +70,81 @@ export class PacketEncoder {
   static encode<T extends HandledPacketType>(
     type: T,
     data: PacketData<T>,
+    version: ProtocolVersion = PROTOCOL_VERSION,
   ): Buffer {
-    if (type === TX_PACKET.ESPNOW_TX) {
-      const { mac, payload } =
+    if (
+      type === TX_PACKET.ESPNOW_TX ||
+      type === TX_PACKET.ESPNOW_TX_MAILBOX
+    ) {
+      const { mac, payload, seq = 0 } =
         data as PacketTypeDataMap[typeof TX_PACKET.ESPNOW_TX];
       return this.wrap(
-        PACKET_BYTE[TX_PACKET.ESPNOW_TX],
+        PACKET_BYTE[type],
         Buffer.concat([
           MAC.toBuffer(mac),
-          Buffer.from([payload.length]),
+          Buffer.from([seq, payload.length]),
           payload,
         ]),
+        version,
+      );
+    }
+
+    if (type === TX_PACKET.GATEWAY_CONFIG) {
+      const { key, value } =
+        data as PacketTypeDataMap[typeof TX_PACKET.GATEWAY_CONFIG];
+      return this.wrap(
+        PACKET_BYTE[TX_PACKET.GATEWAY_CONFIG],
+        Buffer.concat([Buffer.from([key, value.length]), value]),
+        version,
+      );
+    }
+
+    if (type === TX_PACKET.SERIAL_BAUD) {
+      const { baud } = data as PacketTypeDataMap[typeof TX_PACKET.SERIAL_BAUD];
+      const body = Buffer.alloc(4);
+      body.writeUInt32LE(baud, 0);
+      return this.wrap(PACKET_BYTE[TX_PACKET.SERIAL_BAUD], body, version);
+    }
+
+    if (type === TX_PACKET.RX_FILTER) {
+      const { defaultAction, minRssi, rules } =
+        data as PacketTypeDataMap[typeof TX_PACKET.RX_FILTER];
+      if (rules.length > RX_FILTER_MAX_RULES) {
+        throw new Error(`RX_FILTER holds at most ${RX_FILTER_MAX_RULES} rules`);
+      }
+      return this.wrap(
+        PACKET_BYTE[TX_PACKET.RX_FILTER],
+        Buffer.concat([
+          Buffer.from([defaultAction, minRssi & 0xff, rules.length]),
+          ...rules.map(r => this.encodeRxFilterRule(r)),
+        ]),
+        version,
       );
     }
 
     if (type === "RAW") {
       const { type, payload } = data as PacketTypeDataMap["RAW"];
-      return this.wrap(type, payload);
+      return this.wrap(type, payload, version);
     }
 
     throw new Error(`Unsupported packet type ${String(type)}`);
   }
+
+  /* <ACTION><FLAGS><MAC(6)><PREFIX_LEN><PREFIX(8)>, always 17 bytes */
+  private static encodeRxFilterRule({
+    action,
+    mac,
+    prefix = Buffer.alloc(0),
+  }: RxFilterRule): Buffer {
+    if (prefix.length > RX_FILTER_MAX_PREFIX) {
+      throw new Error(`RX_FILTER prefix over ${RX_FILTER_MAX_PREFIX} bytes`);
+    }
+    const rule = Buffer.alloc(1 + 1 + 6 + 1 + RX_FILTER_MAX_PREFIX);
+    rule[0] = action;
+    rule[1] = mac ? 0x01 : 0x00;
+    if (mac) MAC.toBuffer(mac).copy(rule, 2);
+    rule[8] = prefix.length;
+    prefix.copy(rule, 9);
+    return rule;
+  }
 }
@@ -1,19 +1,110 @@
 export const TX_PACKET = {
+  GATEWAY_CONFIG: "GATEWAY_CONFIG",
+  SERIAL_BAUD: "SERIAL_BAUD",
+  RX_FILTER: "RX_FILTER",
   ESPNOW_TX: "ESPNOW_TX",
+  ESPNOW_TX_MAILBOX: "ESPNOW_TX_MAILBOX",
 } as const;
 export type TxPacket = (typeof TX_PACKET)[keyof typeof TX_PACKET];
 
 export const RX_PACKET = {
   GATEWAY_INIT: "GATEWAY_INIT",
+  SERIAL_BAUD_ACK: "SERIAL_BAUD_ACK",
+  GATEWAY_STATS: "GATEWAY_STATS",
+  GATEWAY_PROFILE: "GATEWAY_PROFILE",
+  GATEWAY_PEERS: "GATEWAY_PEERS",
+  RX_FILTER_HITS: "RX_FILTER_HITS",
   ESPNOW_RX: "ESPNOW_RX",
   ESPNOW_TX_STATUS: "ESPNOW_TX_STATUS",
+  ESPNOW_RX_BATCH: "ESPNOW_RX_BATCH",
+  ESPNOW_TX_CREDITS: "ESPNOW_TX_CREDITS",
 } as const;
 export type RxPacket = (typeof RX_PACKET)[keyof typeof RX_PACKET];
 
 export const PACKET_BYTE = {
   [RX_PACKET.GATEWAY_INIT]: 0x01,
+  [RX_PACKET.SERIAL_BAUD_ACK]: 0x02,
+  [RX_PACKET.GATEWAY_STATS]: 0x03,
+  [RX_PACKET.GATEWAY_PROFILE]: 0x04,
+  [RX_PACKET.GATEWAY_PEERS]: 0x05,
+  [RX_PACKET.RX_FILTER_HITS]: 0x06,
+  [TX_PACKET.GATEWAY_CONFIG]: 0x10,
+  [TX_PACKET.SERIAL_BAUD]: 0x11,
+  [TX_PACKET.RX_FILTER]: 0x12,
   [RX_PACKET.ESPNOW_RX]: 0x20,
   [TX_PACKET.ESPNOW_TX]: 0x21,
   [RX_PACKET.ESPNOW_TX_STATUS]: 0x22,
+  [RX_PACKET.ESPNOW_RX_BATCH]: 0x23,
+  [RX_PACKET.ESPNOW_TX_CREDITS]: 0x24,
+  [TX_PACKET.ESPNOW_TX_MAILBOX]: 0x25,
 } as const satisfies Record<RxPacket | TxPacket, number>;
 export type Packet = RxPacket | TxPacket;
+
+/* GATEWAY_CONFIG keys */
+export const CONFIG_KEY = {
+  RX_BATCH: 0x01,
+  TX_RETRY: 0x02,
+  STATS: 0x03,
+  PROFILE: 0x04,
+  DEDUP: 0x05,
+  PEERS: 0x06,
+  FILTER_HITS: 0x07,
+} as const;
+export type ConfigKey = (typeof CONFIG_KEY)[keyof typeof CONFIG_KEY];
+
+/* GATEWAY_STATS counters in wire order, append only */
+export const STATS_COUNTERS = [
+  "serial_frames",
+  "serial_crc_errors",
+  "serial_timeouts",
+  "espnow_rx_frames",
+  "espnow_rx_drops",
+  "espnow_tx_ok",
+  "espnow_tx_failed",
+  "espnow_tx_retries",
+  "espnow_tx_queue_full",
+  "espnow_rx_duplicates",
+  "espnow_rx_filtered",
+] as const;
+export type StatsCounter = (typeof STATS_COUNTERS)[number];
+
+/* GATEWAY_PROFILE probes in wire order, append only */
+export const PROFILE_PROBES = [
+  "loop",
+  "serial_parse",
+  "espnow_rx_callback",
+  "espnow_tx_callback",
+] as const;
+export type ProfileProbe = (typeof PROFILE_PROBES)[number];
+
+/* GATEWAY_CONFIG `PROFILE` flags */
+export const PROFILE_FLAG = {
+  CLEAR: 0x01,
+} as const;
+
+/* RX_FILTER actions and limits */
+export const RX_FILTER_ACTION = {
+  ALLOW: 0x00,
+  DENY: 0x01,
+} as const;
+export type RxFilterAction =
+  (typeof RX_FILTER_ACTION)[keyof typeof RX_FILTER_ACTION];
+
+export const RX_FILTER_MAX_RULES = 8;
+export const RX_FILTER_MAX_PREFIX = 8;
+
+/* SERIAL_BAUD_ACK statuses */
+export const BAUD_STATUS = {
+  SWITCHING: 0x00,
+  CONFIRMED: 0x01,
+  REJECTED: 0x02,
+  REVERTED: 0x03,
+} as const;
+
+/* ESPNOW_TX_STATUS statuses */
+export const TX_STATUS = {
+  OK: 0x00,
+  FAILED: 0x01,
+  QUEUE_FULL: 0x02,
+  REPLACED: 0x03,
+} as const;
@@ -0,0 +1,13 @@
+export const PROTOCOL_VERSION_V2 = 0x02 as const;
+export const FRAME_DELIMITER = 0x00 as const;
+
+export const SIZE_V2 = {
+  VERSION: 1,
+  TYPE: 1,
+  CRC: 2,
+} as const;
+
+export const FIXED_HEADER_SIZE_V2 = SIZE_V2.VERSION + SIZE_V2.TYPE;
+
+/* Largest encoded frame the gateway emits, longer runs are line noise */
+export const MAX_FRAME_SIZE_V2 = 600;
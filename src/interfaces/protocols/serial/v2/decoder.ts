@@ -0,0 +1,50 @@
+import EventEmitter from "events";
+
+import { PacketDecoder, type DecodedPacket } from "../v1/decoder";
+import { PACKET_BYTE, RX_PACKET } from "../v1/packets";
+import { FRAME_DELIMITER, MAX_FRAME_SIZE_V2 } from "./constants";
+import { unframeV2 } from "./frame";
+
+const MODULE_TAG = "[DECODER_V2]";
+
+const RX_PACKET_BYTES = Object.values(RX_PACKET).map(
+  p => PACKET_BYTE[p],
+) as number[];
+
+type PacketDecoderEvents = {
+  packet: [DecodedPacket];
+};
+
+/* Splits the stream on FRAME_DELIMITER, a bad frame never costs the next one */
+export class PacketDecoderV2 extends EventEmitter<PacketDecoderEvents> {
+  private buffer = Buffer.alloc(0);
+
+  feed(chunk: Buffer): void {
+    this.buffer = Buffer.concat([this.buffer, chunk]);
+
+    let end: number;
+    while ((end = this.buffer.indexOf(FRAME_DELIMITER)) !== -1) {
+      const encoded = this.buffer.subarray(0, end);
+      this.buffer = this.buffer.subarray(end + 1);
+      if (encoded.length) this.decodeFrame(encoded);
+    }
+
+    // V1 traffic or noise without delimiters, keep what could still be a frame
+    if (this.buffer.length > MAX_FRAME_SIZE_V2) {
+      this.buffer = this.buffer.subarray(-MAX_FRAME_SIZE_V2);
+    }
+  }
+
+  private decodeFrame(encoded: Buffer): void {
+    const frame = unframeV2(encoded);
+    if (!frame || !RX_PACKET_BYTES.includes(frame.type)) return;
+
+    try {
+      PacketDecoder.decodeBody(frame.type, frame.body).forEach(p =>
+        this.emit("packet", p),
+      );
+    } catch (err) {
+      console.warn(MODULE_TAG, "Dropping malformed frame", err);
+    }
+  }
+}
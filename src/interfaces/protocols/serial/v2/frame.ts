@@ -0,0 +1,34 @@
+import {
+  FIXED_HEADER_SIZE_V2,
+  FRAME_DELIMITER,
+  PROTOCOL_VERSION_V2,
+  SIZE_V2,
+} from "./constants";
+import { cobsDecode, cobsEncode, crc16 } from "./utils";
+
+/* COBS(<VERSION><TYPE><TDATA><CRC16 LE>) followed by the delimiter */
+export const frameV2 = (type: number, body: Buffer): Buffer => {
+  const raw = Buffer.alloc(FIXED_HEADER_SIZE_V2 + body.length + SIZE_V2.CRC);
+  raw[0] = PROTOCOL_VERSION_V2;
+  raw[1] = type;
+  body.copy(raw, FIXED_HEADER_SIZE_V2);
+  raw.writeUInt16LE(
+    crc16(raw.subarray(0, raw.length - SIZE_V2.CRC)),
+    raw.length - SIZE_V2.CRC,
+  );
+  return Buffer.concat([cobsEncode(raw), Buffer.from([FRAME_DELIMITER])]);
+};
+
+/* One encoded frame without its delimiter, null when it does not check out */
+export const unframeV2 = (
+  encoded: Buffer,
+): { type: number; body: Buffer } | null => {
+  const raw = cobsDecode(encoded);
+  if (!raw || raw.length < FIXED_HEADER_SIZE_V2 + SIZE_V2.CRC) return null;
+  if (raw[0] !== PROTOCOL_VERSION_V2) return null;
+
+  const crcAt = raw.length - SIZE_V2.CRC;
+  if (raw.readUInt16LE(crcAt) !== crc16(raw.subarray(0, crcAt))) return null;
+
+  return { type: raw[1]!, body: raw.subarray(FIXED_HEADER_SIZE_V2, crcAt) };
+};
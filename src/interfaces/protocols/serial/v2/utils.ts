@@ -0,0 +1,56 @@
+import { FRAME_DELIMITER } from "./constants";
+
+/* CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff) */
+export const crc16 = (buf: Buffer): number => {
+  let crc = 0xffff;
+  for (const byte of buf) {
+    crc ^= byte << 8;
+    for (let i = 0; i < 8; i++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    crc &= 0xffff;
+  }
+  return crc;
+};
+
+/* COBS encoding, the result never contains FRAME_DELIMITER */
+export const cobsEncode = (buf: Buffer): Buffer => {
+  const out: number[] = [0];
+  let codeAt = 0;
+  let code = 1;
+
+  for (const byte of buf) {
+    if (byte !== FRAME_DELIMITER) {
+      out.push(byte);
+      if (++code < 0xff) continue;
+    }
+    out[codeAt] = code;
+    codeAt = out.length;
+    out.push(0);
+    code = 1;
+  }
+
+  out[codeAt] = code;
+  return Buffer.from(out);
+};
+
+/* Inverse of cobsEncode, null on a malformed frame */
+export const cobsDecode = (buf: Buffer): Buffer | null => {
+  const out: number[] = [];
+  let i = 0;
+
+  while (i < buf.length) {
+    const code = buf[i++]!;
+    if (code === FRAME_DELIMITER) return null;
+
+    for (let j = 1; j < code; j++) {
+      if (i >= buf.length) return null;
+      out.push(buf[i++]!);
+    }
+
+    // A full block carries no implied zero, neither does the last one
+    if (code !== 0xff && i < buf.length) out.push(0);
+  }
+
+  return Buffer.from(out);
+};
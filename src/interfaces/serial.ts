@@ -8,14 +8,30 @@ import { createLogger } from "@/utils/logger";
 import { sleep } from "@/utils/timers";
 
 import {
+  BAUD_STATUS,
+  CONFIG_KEY,
   PacketDecoder,
+  PacketDecoderV2,
   PacketEncoder,
+  PROFILE_FLAG,
+  RX_FILTER_ACTION,
+  RX_FILTER_MAX_RULES,
+  RX_PACKET,
+  TX_PACKET,
+  TX_STATUS,
   type DecodedPacket,
+  type EspNowTxCreditsPacket,
   type HandledPacketType,
   type PacketData,
+  type RxFilterRule,
+  type SerialBaudAckPacket,
 } from "./protocols/serial";
 
 const RECONNECT_DELAY_MS = 2000;
+const BAUD_ACK_TIMEOUT_MS = 1500;
+const BAUD_KEEPALIVE_MS = 10_000; // well inside the gateway's 30 s idle fallback
+const TX_PENDING_MAX = 64;
+const TX_CREDITS_TIMEOUT_MS = 5000; // stalled this long, probe with a frame
 
 export const slog = createLogger("SERIAL", rgb(253, 253, 150));
 
@@ -32,15 +48,73 @@ interface SerialInterfaceEventMap {
 
 export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
   private port?: SerialPort;
+  // The gateway boots speaking V1 and answers in whatever version it last heard
   private readonly decoder = new PacketDecoder();
+  private readonly decoderV2 = new PacketDecoderV2();
 
   private isReady = false;
   private isStopping = false;
 
+  private baudRate = env.SERIAL_BAUD_RATE;
+  private isNegotiating = false;
+  private keepalive?: NodeJS.Timeout;
+
+  // ESPNOW_TX flow control, credits stay null until the gateway advertises any
+  private txSeq = 0;
+  private txCredits: number | null = null;
+  private readonly txPending: PacketData<typeof TX_PACKET.ESPNOW_TX>[] = [];
+  // Until this link sends an ESPNOW_TX, credits carry the gateway's last seq,
+  // possibly one from a previous host session
+  private txSynced = false;
+  private txStall?: NodeJS.Timeout;
+  private txProbe?: {
+    seq: number;
+    data: PacketData<typeof TX_PACKET.ESPNOW_TX>;
+  };
+
+  // ESPNOW_TX_MAILBOX takes no credits, its seq counts on its own
+  private mailSeq = 0;
+
   constructor() {
     super();
 
-    this.decoder.on("packet", p => this.emit("packet", p));
+    const onPacket = (p: DecodedPacket) => {
+      if (p.type === RX_PACKET.GATEWAY_INIT) {
+        this.txSeq = 0; // the gateway counts credits from seq 0 after boot
+        this.txSynced = false;
+        this.configureGateway();
+      }
+      if (p.type === RX_PACKET.ESPNOW_TX_CREDITS) this.updateCredits(p);
+      if (
+        p.type === RX_PACKET.ESPNOW_TX_STATUS &&
+        p.status === TX_STATUS.QUEUE_FULL
+      ) {
+        const probe = this.txProbe;
+        if (probe?.seq === p.seq) {
+          // Only sent to learn the credits, keep it for when they come back
+          this.txPending.unshift(probe.data);
+        } else {
+          slog.warn("Gateway TX queue full, dropped seq", p.seq);
+        }
+      }
+      if (
+        p.type === RX_PACKET.ESPNOW_TX_STATUS &&
+        p.status === TX_STATUS.REPLACED
+      ) {
+        slog.debug("Gateway mailbox replaced seq", p.seq);
+      }
+      if (
+        p.type === RX_PACKET.SERIAL_BAUD_ACK &&
+        p.status === BAUD_STATUS.REVERTED &&
+        !this.isNegotiating
+      ) {
+        // Gateway fell back to its boot rate after the link went quiet
+        this.configureGateway();
+      }
+      this.emit("packet", p);
+    };
+    this.decoder.on("packet", onPacket);
+    this.decoderV2.on("packet", onPacket);
   }
 
   get isConnected() {
@@ -55,6 +129,7 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
         this.attach(this.port);
         this.isReady = true;
         this.emit("connected");
+        this.configureGateway();
         return;
       } catch (err) {
         this.emit("error", err as Error);
@@ -66,6 +141,8 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
   async stop(): Promise<void> {
     this.isStopping = true;
     this.isReady = false;
+    clearInterval(this.keepalive);
+    clearTimeout(this.txStall);
     if (this.port?.isOpen) {
       await new Promise<void>(res => this.port!.close(() => res()));
     }
@@ -82,9 +159,11 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
 
   private open(): Promise<SerialPort> {
     return new Promise((resolve, reject) => {
+      // The gateway boots at SERIAL_BAUD_RATE, faster rates are negotiated
+      this.baudRate = env.SERIAL_BAUD_RATE;
       const port = new SerialPort({
         path: env.SERIAL_PORT,
-        baudRate: env.SERIAL_BAUD_RATE,
+        baudRate: this.baudRate,
         autoOpen: false,
       });
       port.open(err => (err ? reject(err) : resolve(port)));
@@ -95,6 +174,7 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
     port.on("data", buf => {
       this.emit("data", buf);
       this.decoder.feed(buf);
+      this.decoderV2.feed(buf);
     });
 
     port.on("error", err => {
@@ -104,6 +184,13 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
 
     port.on("close", () => {
       this.isReady = false;
+      this.txCredits = null;
+      this.txSynced = false;
+      this.txPending.length = 0;
+      this.txProbe = undefined;
+      clearTimeout(this.txStall);
+      this.txStall = undefined;
+      clearInterval(this.keepalive);
       this.emit("disconnected");
       if (!this.isStopping) void this.reconnectLoop();
     });
@@ -122,6 +209,174 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
     await sleep(200);
   }
 
+  /* Opt in to gateway features this host understands, lost on gateway reboot */
+  private configureGateway(): void {
+    const rxBatch = Buffer.alloc(4);
+    rxBatch.writeUInt16LE(env.SERIAL_RX_BATCH_MAX_BYTES, 0);
+    rxBatch.writeUInt16LE(env.SERIAL_RX_BATCH_MAX_AGE_MS, 2);
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.RX_BATCH,
+      value: rxBatch,
+    });
+
+    const txRetry = Buffer.alloc(5);
+    txRetry.writeUInt8(env.SERIAL_TX_RETRY_ATTEMPTS, 0);
+    txRetry.writeUInt16LE(env.SERIAL_TX_RETRY_BACKOFF_MS, 1);
+    txRetry.writeUInt16LE(env.SERIAL_TX_RETRY_MAX_BACKOFF_MS, 3);
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.TX_RETRY,
+      value: txRetry,
+    });
+
+    const stats = Buffer.alloc(2);
+    stats.writeUInt16LE(env.SERIAL_STATS_INTERVAL_S, 0);
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.STATS,
+      value: stats,
+    });
+
+    const dedup = Buffer.alloc(2);
+    dedup.writeUInt16LE(env.SERIAL_RX_DEDUP_WINDOW_MS, 0);
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.DEDUP,
+      value: dedup,
+    });
+
+    this.configureRxFilter();
+
+    const target = env.SERIAL_TARGET_BAUD_RATE;
+    if (target && target !== this.baudRate) void this.negotiateBaudRate(target);
+  }
+
+  /* Denied MACs first, then the allowed ones, see RX_FILTER */
+  private configureRxFilter(): void {
+    const { DENY, ALLOW } = RX_FILTER_ACTION;
+    const allow: RxFilterRule[] = [
+      ...env.SERIAL_RX_ALLOW_MACS.map(mac => ({ action: ALLOW, mac })),
+      ...env.SERIAL_RX_ALLOW_PREFIXES.map(hex => ({
+        action: ALLOW,
+        prefix: Buffer.from(hex, "hex"),
+      })),
+    ];
+    const rules: RxFilterRule[] = [
+      ...env.SERIAL_RX_DENY_MACS.map(mac => ({ action: DENY, mac })),
+      ...allow,
+    ];
+
+    if (rules.length > RX_FILTER_MAX_RULES) {
+      slog.warn("Gateway takes", RX_FILTER_MAX_RULES, "RX filter rules");
+      return;
+    }
+
+    this.send(TX_PACKET.RX_FILTER, {
+      defaultAction: allow.length ? DENY : ALLOW,
+      minRssi: env.SERIAL_RX_MIN_RSSI,
+      rules,
+    });
+  }
+
+  /* Gateway answers with RX_FILTER_HITS */
+  requestFilterHits(): void {
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.FILTER_HITS,
+      value: Buffer.alloc(0),
+    });
+  }
+
+  /* Gateway answers with one GATEWAY_PROFILE per probe */
+  requestProfile(clear = false): void {
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.PROFILE,
+      value: Buffer.from([clear ? PROFILE_FLAG.CLEAR : 0]),
+    });
+  }
+
+  /* Gateway answers with GATEWAY_PEERS */
+  requestPeers(): void {
+    this.send(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.PEERS,
+      value: Buffer.alloc(0),
+    });
+  }
+
+  /* Ask the gateway for a faster link, see SERIAL_BAUD in SERIAL_V1.md */
+  private async negotiateBaudRate(target: number): Promise<void> {
+    if (this.isNegotiating) return;
+    this.isNegotiating = true;
+    clearInterval(this.keepalive);
+
+    try {
+      this.send(TX_PACKET.SERIAL_BAUD, { baud: target });
+      const ack = await this.waitBaudAck();
+      if (ack?.status !== BAUD_STATUS.SWITCHING) {
+        slog.warn("Gateway did not switch to", target, "baud");
+        return;
+      }
+
+      await this.updateBaudRate(target);
+
+      // Any valid frame at the new rate confirms the switch
+      this.send(TX_PACKET.SERIAL_BAUD, { baud: target });
+      const confirm = await this.waitBaudAck();
+      if (confirm?.status !== BAUD_STATUS.CONFIRMED) {
+        slog.warn("No confirmation at", target, "baud, falling back");
+        await this.updateBaudRate(env.SERIAL_BAUD_RATE);
+        return;
+      }
+
+      slog.info("Serial link running at", target, "baud");
+      this.keepalive = setInterval(
+        () => void this.checkBaudRate(),
+        BAUD_KEEPALIVE_MS,
+      );
+    } catch (err) {
+      this.emit("error", err as Error);
+    } finally {
+      this.isNegotiating = false;
+    }
+  }
+
+  /* Keeps the gateway at the negotiated rate and notices when it rebooted */
+  private async checkBaudRate(): Promise<void> {
+    if (this.isNegotiating) return;
+
+    this.send(TX_PACKET.SERIAL_BAUD, { baud: this.baudRate });
+    const ack = await this.waitBaudAck();
+    if (ack?.status === BAUD_STATUS.CONFIRMED) return;
+
+    slog.warn("Lost gateway at", this.baudRate, "baud, renegotiating");
+    clearInterval(this.keepalive);
+    await this.updateBaudRate(env.SERIAL_BAUD_RATE);
+    this.configureGateway();
+  }
+
+  private waitBaudAck(): Promise<SerialBaudAckPacket | undefined> {
+    return new Promise(resolve => {
+      const onPacket = (p: DecodedPacket) => {
+        if (p.type !== RX_PACKET.SERIAL_BAUD_ACK) return;
+        clearTimeout(timer);
+        this.off("packet", onPacket);
+        resolve(p);
+      };
+      const timer = setTimeout(() => {
+        this.off("packet", onPacket);
+        resolve(undefined);
+      }, BAUD_ACK_TIMEOUT_MS);
+      this.on("packet", onPacket);
+    });
+  }
+
+  private updateBaudRate(baudRate: number): Promise<void> {
+    return new Promise((resolve, reject) => {
+      if (!this.port) return reject(new Error("No port to update"));
+      this.port.update({ baudRate }, err => {
+        if (err) return reject(err);
+        this.baudRate = baudRate;
+        resolve();
+      });
+    });
+  }
+
   private write(buf: Buffer): boolean {
     if (!this.isConnected || !this.port) return false;
     this.port.write(buf, err => err && this.emit("error", err));
@@ -129,7 +384,77 @@ export class SerialInterface extends EventEmitter<SerialInterfaceEventMap> {
   }
 
   send<T extends HandledPacketType>(type: T, data: PacketData<T>): void {
-    const buf = PacketEncoder.encode(type, data);
+    if (type === TX_PACKET.ESPNOW_TX) {
+      return this.sendEspNowTx(data as PacketData<typeof TX_PACKET.ESPNOW_TX>);
+    }
+    if (type === TX_PACKET.ESPNOW_TX_MAILBOX) {
+      this.mailSeq = (this.mailSeq + 1) & 0xff;
+      return this.writePacket(TX_PACKET.ESPNOW_TX_MAILBOX, {
+        ...(data as PacketData<typeof TX_PACKET.ESPNOW_TX_MAILBOX>),
+        seq: this.mailSeq,
+      });
+    }
+    this.writePacket(type, data);
+  }
+
+  /* Waits for gateway TX queue slots, see ESPNOW_TX_CREDITS in SERIAL_V1.md */
+  private sendEspNowTx(data: PacketData<typeof TX_PACKET.ESPNOW_TX>): void {
+    if (this.txPending.length >= TX_PENDING_MAX) {
+      slog.warn("Dropping ESPNOW_TX, gateway is not keeping up");
+      this.txPending.shift();
+    }
+    this.txPending.push(data);
+    this.drainEspNowTx();
+  }
+
+  private updateCredits({ free, seq }: EspNowTxCreditsPacket): void {
+    // Nothing of ours on the wire yet, carry on from the gateway's count
+    if (!this.txSynced) this.txSeq = seq;
+    // Frames sent after `seq` were still on the wire when the gateway counted
+    const inFlight = (this.txSeq - seq) & 0xff;
+    this.txCredits = Math.max(0, free - inFlight);
+    this.txProbe = undefined;
+    clearTimeout(this.txStall);
+    this.txStall = undefined;
+    this.drainEspNowTx();
+  }
+
+  private drainEspNowTx(): void {
+    while (this.txPending.length && this.txCredits !== 0) {
+      const data = this.txPending.shift()!;
+      this.txSeq = (this.txSeq + 1) & 0xff;
+      this.txSynced = true;
+      if (this.txCredits !== null) this.txCredits--;
+      this.writePacket(TX_PACKET.ESPNOW_TX, { ...data, seq: this.txSeq });
+    }
+
+    // Armed once per stall, later sends must not push the probe back
+    if (this.txPending.length && !this.txStall && this.isConnected) {
+      this.txStall = setTimeout(
+        () => this.probeCredits(),
+        TX_CREDITS_TIMEOUT_MS,
+      );
+    }
+  }
+
+  /* The gateway answers any ESPNOW_TX with credits, QUEUE_FULL included, so
+     one frame sent anyway recovers from lost or stale credit packets */
+  private probeCredits(): void {
+    slog.warn("No ESPNOW_TX credits in", TX_CREDITS_TIMEOUT_MS, "ms, probing");
+    this.txStall = undefined;
+    this.txCredits = 1;
+    this.txProbe = {
+      seq: (this.txSeq + 1) & 0xff,
+      data: this.txPending[0]!,
+    };
+    this.drainEspNowTx();
+  }
+
+  private writePacket<T extends HandledPacketType>(
+    type: T,
+    data: PacketData<T>,
+  ): void {
+    const buf = PacketEncoder.encode(type, data, env.SERIAL_PROTOCOL_VERSION);
     if (this.write(buf)) this.emit("write", { type, data });
     else slog.warn("Dropping write, not connected");
   }
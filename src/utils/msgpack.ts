@@ -0,0 +1,177 @@
+/**
+ * Minimal MessagePack codec for NowLink payloads: nil, booleans, numbers,
+ * strings, binary, arrays and string keyed maps. Extension types are not
+ * supported, `undefined` map values are skipped like JSON.stringify does.
+ */
+
+export function encodeMsgPack(value: unknown): Buffer {
+  const out: Buffer[] = [];
+  write(value, out);
+  return Buffer.concat(out);
+}
+
+export function decodeMsgPack(buf: Buffer): unknown {
+  const reader = { buf, pos: 0 };
+  const value = read(reader);
+  if (reader.pos !== buf.length) throw new Error("Trailing msgpack bytes");
+  return value;
+}
+
+function write(value: unknown, out: Buffer[]): void {
+  if (value === null || value === undefined) {
+    out.push(Buffer.from([0xc0]));
+  } else if (typeof value === "boolean") {
+    out.push(Buffer.from([value ? 0xc3 : 0xc2]));
+  } else if (typeof value === "number") {
+    out.push(encodeNumber(value));
+  } else if (typeof value === "string") {
+    const str = Buffer.from(value);
+    out.push(header(str.length, 0xa0, 31, 0xd9, 0xda, 0xdb), str);
+  } else if (Buffer.isBuffer(value)) {
+    out.push(header(value.length, -1, -1, 0xc4, 0xc5, 0xc6), value);
+  } else if (Array.isArray(value)) {
+    out.push(header(value.length, 0x90, 15, -1, 0xdc, 0xdd));
+    value.forEach(v => write(v, out));
+  } else if (typeof value === "object") {
+    const entries = Object.entries(value).filter(([, v]) => v !== undefined);
+    out.push(header(entries.length, 0x80, 15, -1, 0xde, 0xdf));
+    entries.forEach(([k, v]) => {
+      write(k, out);
+      write(v, out);
+    });
+  } else {
+    throw new Error(`Cannot encode ${typeof value} as msgpack`);
+  }
+}
+
+/* Smallest length header, -1 marks a form the type does not have */
+function header(
+  len: number,
+  fix: number,
+  fixMax: number,
+  b8: number,
+  b16: number,
+  b32: number,
+): Buffer {
+  if (len <= fixMax) return Buffer.from([fix | len]);
+  if (b8 !== -1 && len <= 0xff) return Buffer.from([b8, len]);
+  if (len <= 0xffff) return Buffer.from([b16, len >> 8, len & 0xff]);
+  const buf = Buffer.alloc(5);
+  buf[0] = b32;
+  buf.writeUInt32BE(len, 1);
+  return buf;
+}
+
+function encodeNumber(n: number): Buffer {
+  if (!Number.isInteger(n) || n < -0x80000000 || n > 0xffffffff) {
+    const buf = Buffer.alloc(9);
+    buf[0] = 0xcb;
+    buf.writeDoubleBE(n, 1);
+    return buf;
+  }
+  if (n >= 0 && n <= 0x7f) return Buffer.from([n]);
+  if (n < 0 && n >= -32) return Buffer.from([n & 0xff]);
+
+  if (n >= 0) {
+    if (n <= 0xff) return Buffer.from([0xcc, n]);
+    if (n <= 0xffff) return Buffer.from([0xcd, n >> 8, n & 0xff]);
+    const buf = Buffer.alloc(5);
+    buf[0] = 0xce;
+    buf.writeUInt32BE(n, 1);
+    return buf;
+  }
+
+  if (n >= -0x80) return Buffer.from([0xd0, n & 0xff]);
+  if (n >= -0x8000) {
+    const buf = Buffer.alloc(3);
+    buf[0] = 0xd1;
+    buf.writeInt16BE(n, 1);
+    return buf;
+  }
+  const buf = Buffer.alloc(5);
+  buf[0] = 0xd2;
+  buf.writeInt32BE(n, 1);
+  return buf;
+}
+
+type Reader = { buf: Buffer; pos: number };
+
+function take(r: Reader, n: number): Buffer {
+  if (r.pos + n > r.buf.length) throw new Error("Truncated msgpack");
+  const slice = r.buf.subarray(r.pos, r.pos + n);
+  r.pos += n;
+  return slice;
+}
+
+function read(r: Reader): unknown {
+  const b = take(r, 1)[0]!;
+
+  if (b <= 0x7f) return b;
+  if (b >= 0xe0) return b - 0x100;
+  if ((b & 0xf0) === 0x80) return readMap(r, b & 0x0f);
+  if ((b & 0xf0) === 0x90) return readArray(r, b & 0x0f);
+  if ((b & 0xe0) === 0xa0) return take(r, b & 0x1f).toString();
+
+  switch (b) {
+    case 0xc0:
+      return null;
+    case 0xc2:
+      return false;
+    case 0xc3:
+      return true;
+    case 0xc4:
+      return Buffer.from(take(r, take(r, 1).readUInt8()));
+    case 0xc5:
+      return Buffer.from(take(r, take(r, 2).readUInt16BE()));
+    case 0xc6:
+      return Buffer.from(take(r, take(r, 4).readUInt32BE()));
+    case 0xca:
+      return take(r, 4).readFloatBE();
+    case 0xcb:
+      return take(r, 8).readDoubleBE();
+    case 0xcc:
+      return take(r, 1).readUInt8();
+    case 0xcd:
+      return take(r, 2).readUInt16BE();
+    case 0xce:
+      return take(r, 4).readUInt32BE();
+    case 0xcf:
+      return Number(take(r, 8).readBigUInt64BE());
+    case 0xd0:
+      return take(r, 1).readInt8();
+    case 0xd1:
+      return take(r, 2).readInt16BE();
+    case 0xd2:
+      return take(r, 4).readInt32BE();
+    case 0xd3:
+      return Number(take(r, 8).readBigInt64BE());
+    case 0xd9:
+      return take(r, take(r, 1).readUInt8()).toString();
+    case 0xda:
+      return take(r, take(r, 2).readUInt16BE()).toString();
+    case 0xdb:
+      return take(r, take(r, 4).readUInt32BE()).toString();
+    case 0xdc:
+      return readArray(r, take(r, 2).readUInt16BE());
+    case 0xdd:
+      return readArray(r, take(r, 4).readUInt32BE());
+    case 0xde:
+      return readMap(r, take(r, 2).readUInt16BE());
+    case 0xdf:
+      return readMap(r, take(r, 4).readUInt32BE());
+    default:
+      throw new Error(`Unsupported msgpack type 0x${b.toString(16)}`);
+  }
+}
+
+function readArray(r: Reader, n: number): unknown[] {
+  return Array.from({ length: n }, () => read(r));
+}
+
+function readMap(r: Reader, n: number): Record<string, unknown> {
+  const map: Record<string, unknown> = {};
+  for (let i = 0; i < n; i++) {
+    map[String(read(r))] = read(r);
+  }
+  return map;
+}
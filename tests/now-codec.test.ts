@@ -0,0 +1,156 @@
+import { describe, expect, it } from "vitest";
+
+import {
+  decodeNowPayload,
+  encodeNowPayload,
+  expandNowBatch,
+  getNowHandle,
+  getRediscoverPayload,
+  NOW_CODEC,
+  NOW_MSGPACK_MARKER,
+  nowEntityAddress,
+  withNowEntity,
+} from "@/helpers/espnow";
+import {
+  crc8,
+  PACKET_BYTE,
+  PacketDecoder,
+  PROTOCOL_VERSION,
+  RX_PACKET,
+  SYNC_BYTE,
+} from "@/interfaces/protocols/serial";
+import { decodeMsgPack, encodeMsgPack } from "@/utils/msgpack";
+
+const STATE = {
+  ".t": "h",
+  dev_id: "two_way_device",
+  p: "switch",
+  id: "led_switch",
+  stat: "ON",
+};
+
+describe("msgpack", () => {
+  it("encodes maps the way ArduinoJson does", () => {
+    expect(encodeMsgPack({ id: "a", br: 200 }).toString("hex")).toBe(
+      "82" + "a26964" + "a161" + "a26272" + "ccc8",
+    );
+  });
+
+  it("round trips the value kinds NowLink uses", () => {
+    const value = {
+      ...STATE,
+      br: 255,
+      neg: -3,
+      wide: -40_000,
+      big: 70_000,
+      ratio: 0.5,
+      flags: [true, false, null],
+      long: "x".repeat(40),
+    };
+    expect(decodeMsgPack(encodeMsgPack(value))).toEqual(value);
+  });
+
+  it("skips undefined map values", () => {
+    expect(decodeMsgPack(encodeMsgPack({ id: "a", br: undefined }))).toEqual({
+      id: "a",
+    });
+  });
+
+  it("rejects truncated input", () => {
+    const buf = encodeMsgPack(STATE);
+    expect(() => decodeMsgPack(buf.subarray(0, buf.length - 1))).toThrow();
+  });
+});
+
+describe("NowLink payload codec", () => {
+  it("flags msgpack payloads with the marker byte", () => {
+    const buf = encodeNowPayload(STATE, NOW_CODEC.msgpack);
+    expect(buf[0]).toBe(NOW_MSGPACK_MARKER);
+    expect(buf.length).toBeLessThan(JSON.stringify(STATE).length);
+    expect(decodeNowPayload(buf)).toEqual({
+      payload: STATE,
+      codec: NOW_CODEC.msgpack,
+    });
+  });
+
+  it("keeps JSON as the default", () => {
+    const buf = encodeNowPayload(STATE);
+    expect(buf.toString()).toBe(JSON.stringify(STATE));
+    expect(decodeNowPayload(buf).codec).toBe(NOW_CODEC.json);
+  });
+
+  it("decodes msgpack ESPNOW_RX frames", () => {
+    const payload = encodeNowPayload(STATE, NOW_CODEC.msgpack);
+    const body = Buffer.concat([
+      Buffer.from([0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, -50 & 0xff]),
+      Buffer.from([payload.length]),
+      payload,
+    ]);
+    const typeByte = PACKET_BYTE[RX_PACKET.ESPNOW_RX];
+    const header = Buffer.from([SYNC_BYTE, PROTOCOL_VERSION, typeByte]);
+    const crc = crc8(Buffer.concat([header.subarray(1), body]));
+    const frame = Buffer.concat([header, body, Buffer.from([crc])]);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame);
+
+    expect(pkts).toHaveLength(1);
+    expect(pkts[0].payload).toEqual(STATE);
+    expect(pkts[0].codec).toBe(NOW_CODEC.msgpack);
+  });
+});
+
+describe("NowLink state batches", () => {
+  it("expands into state payloads that carry dev_id", () => {
+    const batch = {
+      ".t": "b",
+      dev_id: "two_way_device",
+      e: [
+        { n: 0, stat: "OFF" },
+        { n: 1, stat: "ON" },
+      ],
+    };
+    expect(expandNowBatch(batch)).toEqual([
+      { ".t": "s", dev_id: "two_way_device", n: 0, stat: "OFF" },
+      { ".t": "s", dev_id: "two_way_device", n: 1, stat: "ON" },
+    ]);
+  });
+
+  it("ignores a batch without states", () => {
+    expect(expandNowBatch({ ".t": "b", dev_id: "x" })).toEqual([]);
+  });
+});
+
+describe("NowLink entity handles", () => {
+  it("reads integer handles only", () => {
+    expect(getNowHandle({ n: 0 })).toBe(0);
+    expect(getNowHandle({ n: 7 })).toBe(7);
+    expect(getNowHandle({ n: "7" })).toBe(undefined);
+    expect(getNowHandle({ id: "led_switch" })).toBe(undefined);
+  });
+
+  it("addresses by handle once one is known", () => {
+    expect(nowEntityAddress("led_switch")).toEqual({ id: "led_switch" });
+    expect(nowEntityAddress("led_switch", 1)).toEqual({ n: 1 });
+  });
+
+  it("fills in the entity a handle stands for", () => {
+    const state = { ".t": "s", dev_id: "two_way_device", n: 1, stat: "ON" };
+    const entity = { id: "led_switch", platform: "switch" };
+    expect(withNowEntity(state, entity)).toEqual({
+      ...state,
+      p: "switch",
+      id: "led_switch",
+    });
+  });
+});
+
+describe("NowLink rediscover", () => {
+  it("asks every entity of every device within the window", () => {
+    const payload = getRediscoverPayload(3000);
+    expect(payload).toEqual({ ".t": "d", w: 3000 });
+    expect(getNowHandle(payload)).toBe(undefined);
+  });
+});
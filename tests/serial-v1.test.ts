@@ -11,6 +11,10 @@ import {
   TX_PACKET,
   RX_PACKET,
   PACKET_BYTE,
+  CONFIG_KEY,
+  BAUD_STATUS,
+  PROFILE_FLAG,
+  RX_FILTER_ACTION,
 } from "@/interfaces/protocols/serial";
 
 // Mock the MAC utility so tests remain self-contained
@@ -53,21 +57,108 @@ describe("PacketEncoder", () => {
     const buf = PacketEncoder.encode(TX_PACKET.ESPNOW_TX, {
       mac: MAC_STRING,
       payload,
+      seq: 7,
     });
 
     expect(buf[0]).toBe(SYNC_BYTE);
     expect(buf[1]).toBe(PROTOCOL_VERSION);
     expect(buf[2]).toBe(PACKET_BYTE[TX_PACKET.ESPNOW_TX]);
+    expect(buf[FIXED_HEADER_SIZE + SIZE.MAC]).toBe(7);
 
-    // Length = header + mac + len + payload + crc
+    // Length = header + mac + seq + len + payload + crc
     expect(buf.length).toBe(
-      FIXED_HEADER_SIZE + SIZE.MAC + SIZE.LEN + payload.length + SIZE.CRC,
+      FIXED_HEADER_SIZE +
+        SIZE.MAC +
+        SIZE.SEQ +
+        SIZE.LEN +
+        payload.length +
+        SIZE.CRC,
     );
 
     const crcExpected = crc8(buf.subarray(1, buf.length - 1));
     expect(buf[buf.length - 1]).toBe(crcExpected);
   });
 
+  it("encodes ESPNOW_TX_MAILBOX with the ESPNOW_TX layout", () => {
+    const payload = Buffer.from(JSON.stringify({ n: 0, stat: "ON" }));
+    const data = { mac: MAC_STRING, payload, seq: 3 };
+    const mail = PacketEncoder.encode(TX_PACKET.ESPNOW_TX_MAILBOX, data);
+    const tx = PacketEncoder.encode(TX_PACKET.ESPNOW_TX, data);
+
+    expect(mail[2]).toBe(0x25);
+    expect(mail.subarray(3, -1)).toEqual(tx.subarray(3, -1));
+    expect(mail[mail.length - 1]).toBe(
+      crc8(mail.subarray(1, mail.length - 1)),
+    );
+  });
+
+  it("encodes RX_FILTER with fixed size rules", () => {
+    const buf = PacketEncoder.encode(TX_PACKET.RX_FILTER, {
+      defaultAction: RX_FILTER_ACTION.DENY,
+      minRssi: -85,
+      rules: [
+        { action: RX_FILTER_ACTION.DENY, mac: MAC_STRING },
+        { action: RX_FILTER_ACTION.ALLOW, prefix: Buffer.from("7bc1", "hex") },
+      ],
+    });
+    const body = buf.subarray(FIXED_HEADER_SIZE, -1);
+
+    expect(buf[2]).toBe(0x12);
+    expect(body.length).toBe(3 + 2 * 17);
+    expect([body[0], body.readInt8(1), body[2]]).toEqual([1, -85, 2]);
+    expect(body.subarray(3, 11)).toEqual(
+      Buffer.concat([Buffer.from([1, 1]), MAC_BUFFER]),
+    );
+    expect(body.subarray(20, 29)).toEqual(
+      Buffer.from([0, 0, 0, 0, 0, 0, 0, 0, 2]),
+    );
+    expect(body.subarray(29, 31)).toEqual(Buffer.from([0x7b, 0xc1]));
+  });
+
+  it("decodes RX_FILTER_HITS", () => {
+    const body = Buffer.alloc(4 + 4 + 1 + 2 * 4);
+    body.writeUInt32LE(5, 0);
+    body.writeUInt32LE(100, 4);
+    body[8] = 2;
+    body.writeUInt32LE(7, 9);
+    body.writeUInt32LE(300, 13);
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.RX_FILTER_HITS], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame);
+
+    expect(pkts).toEqual([
+      {
+        type: RX_PACKET.RX_FILTER_HITS,
+        rssiHits: 5,
+        defaultHits: 100,
+        hits: [7, 300],
+      },
+    ]);
+  });
+
+  it("encodes GATEWAY_CONFIG packet", () => {
+    const value = Buffer.from([0x00, 0x01, 0x14, 0x00]);
+    const buf = PacketEncoder.encode(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.RX_BATCH,
+      value,
+    });
+
+    expect(buf[2]).toBe(PACKET_BYTE[TX_PACKET.GATEWAY_CONFIG]);
+    expect(buf[3]).toBe(CONFIG_KEY.RX_BATCH);
+    expect(buf[4]).toBe(value.length);
+    expect(buf.subarray(5, -1)).toEqual(value);
+    expect(buf[buf.length - 1]).toBe(crc8(buf.subarray(1, buf.length - 1)));
+  });
+
+  it("encodes SERIAL_BAUD packet little endian", () => {
+    const buf = PacketEncoder.encode(TX_PACKET.SERIAL_BAUD, { baud: 921600 });
+    expect(buf[2]).toBe(PACKET_BYTE[TX_PACKET.SERIAL_BAUD]);
+    expect(buf.subarray(3, -1)).toEqual(Buffer.from([0x00, 0x10, 0x0e, 0x00]));
+  });
+
   it("encodes RAW type packet", () => {
     const DATA = Buffer.from([0x01, 0x02, 0x03]);
     const t = 0x30;
@@ -110,8 +201,117 @@ describe("PacketDecoder", () => {
     expect(pkt.payload).toEqual(payloadObj);
   });
 
+  it("decodes SERIAL_BAUD_ACK", async () => {
+    const body = Buffer.from([0x00, 0xc2, 0x01, 0x00, BAUD_STATUS.CONFIRMED]);
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.SERIAL_BAUD_ACK], body);
+
+    const dec = new PacketDecoder();
+    const p = new Promise(res => dec.once("packet", res));
+    dec.feed(frame);
+    const pkt: any = await p;
+
+    expect(pkt.type).toBe(RX_PACKET.SERIAL_BAUD_ACK);
+    expect(pkt.baud).toBe(115200);
+    expect(pkt.status).toBe(BAUD_STATUS.CONFIRMED);
+  });
+
+  it("decodes GATEWAY_STATS and skips unknown counters", () => {
+    const counters = Array.from({ length: 12 }, (_, i) => i + 1);
+    const body = Buffer.alloc(4 + 4 + 1 + counters.length * 4);
+    body.writeUInt32LE(123_456, 0);
+    body.writeUInt32LE(40_000, 4);
+    body[8] = counters.length;
+    counters.forEach((c, i) => body.writeUInt32LE(c, 9 + i * 4));
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.GATEWAY_STATS], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame);
+
+    expect(pkts).toHaveLength(1);
+    expect(pkts[0].uptimeMs).toBe(123_456);
+    expect(pkts[0].freeHeap).toBe(40_000);
+    expect(pkts[0].counters.serial_frames).toBe(1);
+    expect(pkts[0].counters.espnow_tx_queue_full).toBe(9);
+    expect(pkts[0].counters.espnow_rx_duplicates).toBe(10);
+    expect(pkts[0].counters.espnow_rx_filtered).toBe(11);
+    expect(Object.keys(pkts[0].counters)).toHaveLength(11);
+  });
+
+  it("decodes GATEWAY_PEERS", () => {
+    const record = Buffer.alloc(6 + 4 + 1 + 4 + 4);
+    MAC_BUFFER.copy(record, 0);
+    record.writeUInt32LE(1500, 6);
+    record.writeInt8(-67, 10);
+    record.writeUInt32LE(42, 11);
+    record.writeUInt32LE(3, 15);
+    const body = Buffer.concat([Buffer.from([2]), record, record]);
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.GATEWAY_PEERS], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame.subarray(0, 12));
+    dec.feed(frame.subarray(12));
+
+    const peer = {
+      mac: MAC_STRING,
+      ageMs: 1500,
+      rssi: -67,
+      frames: 42,
+      duplicates: 3,
+    };
+    expect(pkts).toEqual([
+      { type: RX_PACKET.GATEWAY_PEERS, peers: [peer, peer] },
+    ]);
+  });
+
+  it("decodes GATEWAY_PROFILE", () => {
+    const buckets = [0, 3, 10, 1];
+    const body = Buffer.alloc(1 + 1 + 4 * 4 + 1 + buckets.length * 4);
+    body[0] = 1; // SERIAL_PARSE
+    body[1] = 80;
+    [14, 7, 3, 7].forEach((v, i) => body.writeUInt32LE(v, 2 + i * 4));
+    body[18] = buckets.length;
+    buckets.forEach((b, i) => body.writeUInt32LE(b, 19 + i * 4));
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.GATEWAY_PROFILE], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame.subarray(0, 10));
+    dec.feed(frame.subarray(10));
+
+    expect(pkts).toEqual([
+      {
+        type: RX_PACKET.GATEWAY_PROFILE,
+        probe: "serial_parse",
+        cpuMhz: 80,
+        samples: 14,
+        max: 7,
+        p50: 3,
+        p99: 7,
+        buckets,
+      },
+    ]);
+  });
+
+  it("encodes a GATEWAY_CONFIG profile request", () => {
+    const buf = PacketEncoder.encode(TX_PACKET.GATEWAY_CONFIG, {
+      key: CONFIG_KEY.PROFILE,
+      value: Buffer.from([PROFILE_FLAG.CLEAR]),
+    });
+    expect(buf).toEqual(
+      buildFrame(
+        PACKET_BYTE[TX_PACKET.GATEWAY_CONFIG],
+        Buffer.from([0x04, 1, 0x01]),
+      ),
+    );
+  });
+
   it("decodes ESPNOW_TX_STATUS", async () => {
-    const statusBuf = Buffer.from([0x01]);
+    const statusBuf = Buffer.from([0x2a, 0x01]); // seq, status
     const body = Buffer.concat([MAC_BUFFER, statusBuf]);
     const frame = buildFrame(PACKET_BYTE[RX_PACKET.ESPNOW_TX_STATUS], body);
 
@@ -122,9 +322,102 @@ describe("PacketDecoder", () => {
 
     expect(pkt.type).toBe(RX_PACKET.ESPNOW_TX_STATUS);
     expect(pkt.mac).toBe(MAC_STRING);
+    expect(pkt.seq).toBe(0x2a);
     expect(pkt.status).toBe(0x01);
   });
 
+  it("decodes ESPNOW_TX_CREDITS", () => {
+    const body = Buffer.from([5, 0xfe]); // free, seq
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.ESPNOW_TX_CREDITS], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame);
+
+    expect(pkts).toEqual([
+      { type: RX_PACKET.ESPNOW_TX_CREDITS, free: 5, seq: 0xfe },
+    ]);
+  });
+
+  it("decodes ESPNOW_RX_BATCH into ESPNOW_RX packets", () => {
+    const record = (rssi: number, obj: object) => {
+      const payload = Buffer.from(JSON.stringify(obj));
+      return Buffer.concat([
+        MAC_BUFFER,
+        Buffer.from([rssi & 0xff, payload.length]),
+        payload,
+      ]);
+    };
+
+    const body = Buffer.concat([
+      Buffer.from([2]),
+      record(-40, { id: "a" }),
+      record(-70, { id: "b" }),
+    ]);
+    const frame = buildFrame(PACKET_BYTE[RX_PACKET.ESPNOW_RX_BATCH], body);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame.subarray(0, 12)); // cut inside the first record
+    expect(pkts).toHaveLength(0);
+    dec.feed(frame.subarray(12));
+
+    expect(pkts).toHaveLength(2);
+    expect(pkts.map(p => p.type)).toEqual([
+      RX_PACKET.ESPNOW_RX,
+      RX_PACKET.ESPNOW_RX,
+    ]);
+    expect(pkts.map(p => p.rssi)).toEqual([-40, -70]);
+    expect(pkts.map(p => p.payload.id)).toEqual(["a", "b"]);
+  });
+
+  it("skips batch records that are not NowLink payloads", () => {
+    const record = (payload: Buffer) =>
+      Buffer.concat([
+        MAC_BUFFER,
+        Buffer.from([-50 & 0xff, payload.length]),
+        payload,
+      ]);
+    const wizmote = Buffer.from([0x91, 0x01, 0x00, 0x00, 0x00, 0x20, 0x01]);
+
+    const body = Buffer.concat([
+      Buffer.from([3]),
+      record(Buffer.from(JSON.stringify({ id: "a" }))),
+      record(wizmote),
+      record(Buffer.from(JSON.stringify({ id: "b" }))),
+    ]);
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(buildFrame(PACKET_BYTE[RX_PACKET.ESPNOW_RX_BATCH], body));
+
+    expect(pkts.map(p => p.payload.id)).toEqual(["a", "b"]);
+  });
+
+  it("moves past an ESPNOW_RX frame whose payload does not decode", () => {
+    const rx = (payload: Buffer) =>
+      buildFrame(
+        PACKET_BYTE[RX_PACKET.ESPNOW_RX],
+        Buffer.concat([
+          MAC_BUFFER,
+          Buffer.from([-50 & 0xff, payload.length]),
+          payload,
+        ]),
+      );
+
+    const dec = new PacketDecoder();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(rx(Buffer.from("not json")));
+    expect(pkts).toHaveLength(0);
+    dec.feed(rx(Buffer.from(JSON.stringify({ id: "next" }))));
+
+    expect(pkts.map(p => p.payload.id)).toEqual(["next"]);
+  });
+
   it("skips corrupted CRC", async () => {
     const body = MAC_BUFFER;
     const frame = buildFrame(PACKET_BYTE[RX_PACKET.GATEWAY_INIT], body);
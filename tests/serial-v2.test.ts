@@ -0,0 +1,139 @@
+import { describe, it, expect, vi } from "vitest";
+import {
+  PacketEncoder,
+  PacketDecoderV2,
+  PROTOCOL_VERSION_V2,
+  FRAME_DELIMITER,
+  cobsEncode,
+  cobsDecode,
+  crc16,
+  frameV2,
+  unframeV2,
+  TX_PACKET,
+  RX_PACKET,
+  PACKET_BYTE,
+} from "@/interfaces/protocols/serial";
+
+// Mock the MAC utility so tests remain self-contained
+vi.mock("@/utils/mac", () => {
+  const stringToBuf = (mac: string) =>
+    Buffer.from(mac.split(":").map((b) => parseInt(b, 16)));
+  const bufToString = (buf: Buffer) =>
+    Array.from(buf).map((b) => b.toString(16).padStart(2, "0")).join(":");
+  return {
+    MAC: {
+      toBuffer: stringToBuf,
+      fromBuf: bufToString,
+    },
+  };
+});
+
+const MAC_STRING = "aa:bb:cc:dd:ee:ff";
+const MAC_BUFFER = Buffer.from([0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff]);
+
+const rxFrame = (obj: object) => {
+  const payload = Buffer.from(JSON.stringify(obj));
+  const body = Buffer.concat([
+    MAC_BUFFER,
+    Buffer.from([-42 & 0xff, payload.length]),
+    payload,
+  ]);
+  return frameV2(PACKET_BYTE[RX_PACKET.ESPNOW_RX], body);
+};
+
+describe("utils", () => {
+  it("crc16 matches the CCITT-FALSE check value", () => {
+    expect(crc16(Buffer.from("123456789"))).toBe(0x29b1);
+  });
+
+  it("cobs round trips around the 254 byte block edge", () => {
+    for (const len of [0, 1, 253, 254, 255, 508, 509]) {
+      for (const fill of [0x00, 0x01]) {
+        const buf = Buffer.alloc(len, fill);
+        if (len) buf[len - 1] = 0;
+        const encoded = cobsEncode(buf);
+        expect(encoded.includes(FRAME_DELIMITER)).toBe(false);
+        expect(cobsDecode(encoded)).toEqual(buf);
+      }
+    }
+  });
+});
+
+describe("PacketEncoder", () => {
+  it("encodes ESPNOW_TX packet as V2 frame", () => {
+    const payload = Buffer.alloc(250, 0x5a);
+    const buf = PacketEncoder.encode(
+      TX_PACKET.ESPNOW_TX,
+      { mac: MAC_STRING, payload, seq: 1 },
+      PROTOCOL_VERSION_V2,
+    );
+
+    expect(buf[buf.length - 1]).toBe(FRAME_DELIMITER);
+    expect(buf.subarray(0, -1).includes(FRAME_DELIMITER)).toBe(false);
+
+    const frame = unframeV2(buf.subarray(0, -1));
+    expect(frame?.type).toBe(PACKET_BYTE[TX_PACKET.ESPNOW_TX]);
+    expect(frame?.body.subarray(0, 6)).toEqual(MAC_BUFFER);
+    expect(frame?.body[6]).toBe(1);
+    expect(frame?.body[7]).toBe(250);
+    expect(frame?.body.subarray(8)).toEqual(payload);
+  });
+});
+
+describe("PacketDecoderV2", () => {
+  it("decodes ESPNOW_RX fed in pieces", () => {
+    const frame = rxFrame({ led: true });
+
+    const dec = new PacketDecoderV2();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frame.subarray(0, 5));
+    expect(pkts).toHaveLength(0);
+    dec.feed(frame.subarray(5));
+
+    expect(pkts).toHaveLength(1);
+    expect(pkts[0].type).toBe(RX_PACKET.ESPNOW_RX);
+    expect(pkts[0].mac).toBe(MAC_STRING);
+    expect(pkts[0].rssi).toBe(-42);
+    expect(pkts[0].payload).toEqual({ led: true });
+  });
+
+  it("loses only the corrupted frame", () => {
+    const bad = rxFrame({ id: "bad" });
+    bad[4]! ^= 0x10;
+
+    const dec = new PacketDecoderV2();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(
+      Buffer.concat([
+        rxFrame({ id: "a" }),
+        bad,
+        rxFrame({ id: "b" }),
+      ]),
+    );
+
+    expect(pkts.map(p => p.payload.id)).toEqual(["a", "b"]);
+  });
+
+  it("keeps the NowLink records of a batch with a foreign payload", () => {
+    const record = (payload: Buffer) =>
+      Buffer.concat([
+        MAC_BUFFER,
+        Buffer.from([-50 & 0xff, payload.length]),
+        payload,
+      ]);
+    const body = Buffer.concat([
+      Buffer.from([2]),
+      record(Buffer.from([0x91, 0x01, 0x00, 0x00, 0x00, 0x20, 0x01])),
+      record(Buffer.from(JSON.stringify({ id: "a" }))),
+    ]);
+
+    const dec = new PacketDecoderV2();
+    const pkts: any[] = [];
+    dec.on("packet", p => pkts.push(p));
+    dec.feed(frameV2(PACKET_BYTE[RX_PACKET.ESPNOW_RX_BATCH], body));
+
+    expect(pkts.map(p => p.payload.id)).toEqual(["a"]);
+  });
+});